@@ -2,93 +2,24 @@
 #define FLEXICAMORE_SRC_ENRICHMENT_H_
 
 #include <string>
+#include <utility>  // std::pair
+#include <vector>
 
 #include "cyclus.h"
 
+#include "enrichment_engine.h"
+#include "enrichment_memo.h"
 #include "flexible_input.h"
+#include "flexible_vector_input.h"
+#include "schedule_registry.h"
+#include "uranium_cache.h"
+#include "uranium_tally.h"
 
 namespace flexicamore {
 
-const double kEpsCompMap = 1e-5;
-
-// The SwuConverter is a simple Converter class for material to determine the
-// amount of SWU required for their proposed enrichment.
-class SwuConverter : public cyclus::Converter<cyclus::Material> {
- public:
-  SwuConverter(double feed_assay, double tails_assay)
-      : feed_assay(feed_assay), tails_assay(tails_assay) {}
-  virtual ~SwuConverter() {}
-
-  /// @brief provides a conversion for the SWU required
-  virtual double convert(
-      cyclus::Material::Ptr m,
-      cyclus::Arc const * a = NULL,
-      cyclus::ExchangeTranslationContext<cyclus::Material>
-          const * ctx = NULL) const {
-    cyclus::toolkit::Assays assays(feed_assay,
-                                   cyclus::toolkit::UraniumAssayMass(m),
-                                   tails_assay);
-    return cyclus::toolkit::SwuRequired(m->quantity(), assays);
-  }
-
-  /// @returns true if Converter is a SWUConverter and feed and tails equal
-  virtual bool operator==(Converter& other) const {
-    SwuConverter* cast = dynamic_cast<SwuConverter*>(&other);
-    bool cast_not_null = cast != NULL;
-    bool feed_equal = cyclus::AlmostEq(feed_assay, cast->feed_assay);
-    bool tails_equal = cyclus::AlmostEq(tails_assay, cast->tails_assay);
-
-    return cast_not_null && feed_equal && tails_equal;
-  }
-
- private:
-  double feed_assay;
-  double tails_assay;
-};
-
-// The FeedConverter is a simple Converter class for material to determine the
-// amount of feed required for the proposed enrichment.
-class FeedConverter: public cyclus::Converter<cyclus::Material> {
- public:
-  FeedConverter(double feed_assay, double tails_assay)
-      : feed_assay(feed_assay), tails_assay(tails_assay) {}
-  virtual ~FeedConverter() {}
-
-  /// @brief provides a conversion for the amount of feed required.
-  virtual double convert(
-      cyclus::Material::Ptr m,
-      cyclus::Arc const * a = NULL,
-      cyclus::ExchangeTranslationContext<cyclus::Material>
-          const * ctx = NULL) const {
-    cyclus::toolkit::Assays assays(feed_assay,
-                                   cyclus::toolkit::UraniumAssayMass(m),
-                                   tails_assay);
-    cyclus::toolkit::MatQuery mq(m);
-    std::set<cyclus::Nuc> nucs;
-    nucs.insert(922350000);
-    nucs.insert(922380000);
-
-    // Combined fraction of U235 and U238 in product material `m`.
-    double uranium_frac = mq.mass_frac(nucs);
-    // Feed required to product `m->quantity()` of product.
-    double feed_req = cyclus::toolkit::FeedQty(m->quantity(), assays);
-    return feed_req / uranium_frac;
-  }
-
-  /// @returns true if Converter is a FeedConverter and feed and tails equal
-  virtual bool operator==(Converter& other) const {
-    FeedConverter* cast = dynamic_cast<FeedConverter*>(&other);
-    bool cast_not_null = cast != NULL;
-    bool feed_equal = cyclus::AlmostEq(feed_assay, cast->feed_assay);
-    bool tails_equal = cyclus::AlmostEq(tails_assay, cast->tails_assay);
-
-    return cast_not_null && feed_equal && tails_equal;
-  }
-
- private:
-  double feed_assay;
-  double tails_assay;
-};
+class FlexibleEnrichment;
+typedef EnrichmentEngine<FlexibleEnrichment, FixedFeedPrefs>
+    FlexibleEnrichmentEngine;
 
 /// @class FlexibleEnrichment
 ///
@@ -97,7 +28,8 @@ class FeedConverter: public cyclus::Converter<cyclus::Material> {
 /// input file, e.g., the SWU capacity, can be defined to vary in the course of
 /// the simulation.
 class FlexibleEnrichment : public cyclus::Facility,
-                           public cyclus::toolkit::Position {
+                           public cyclus::toolkit::Position,
+                           public FlexibleEnrichmentEngine {
  public:
   explicit FlexibleEnrichment(cyclus::Context* ctx);
 
@@ -143,21 +75,14 @@ class FlexibleEnrichment : public cyclus::Facility,
   void Tock();
 
  private:
-  bool ValidReq_(const cyclus::Material::Ptr mat);
+  friend FlexibleEnrichmentEngine;
 
-  cyclus::Material::Ptr Enrich_(cyclus::Material::Ptr mat, double qty);
-  cyclus::Material::Ptr Offer_(cyclus::Material::Ptr req);
+  // Tag of the log messages of the facility and its engine.
+  static constexpr const char* kLogTag = "FlxEnr";
+  // Level of the messages on the choice of the feed inventory.
+  static constexpr cyclus::LogLevel kPlanLogLevel = cyclus::LEV_DEBUG5;
 
-  double FeedAssay_(int feed_idx_);
-
-  // This function will probably be needed because of NU *and* LEU *and* DU
-  // *and* reprocessed U enrichment.
-  // TODO *Alternatively* I could conceive to program the enrichment s.t. it
-  // only requests fresh uranium once its stock are empty?
-  void AddFeedMat_(cyclus::Material::Ptr mat, std::string commodity);
-  void AddMat_(cyclus::Material::Ptr mat, std::string commodity);
-  void FeedIdxByPreference_();
-  void RecordEnrichment_(double feed_qty, double swu, std::string feed_commod);
+  void RecordEnrichment_(const EnrichmentPlan& plan);
   void RecordPosition();
 
   // TODO all variables below, notably things like `feed_commod` and
@@ -175,6 +100,9 @@ class FlexibleEnrichment : public cyclus::Facility,
   // misoenrichment's MIsoEnrich (same problem).
   //#pragma cyclus var {}
   std::vector<cyclus::toolkit::ResBuf<cyclus::Material> > feed_inv;
+  // Content of the feed inventories, updated whenever material is added to or
+  // removed from them.
+  std::vector<UraniumTally> feed_tally;
   // TODO maybe feed_idx can be deleted, tbc.
   int feed_idx;
 
@@ -187,6 +115,30 @@ class FlexibleEnrichment : public cyclus::Facility,
            "default for all feed commodities." \
   }
   std::vector<double> feed_commod_prefs;
+
+  #pragma cyclus var { \
+    "default": [], \
+    "tooltip": "Feed commodity preferences change times", \
+    "uilabel": "Feed commodity preferences change times", \
+    "doc": "times at which the feed commodity preferences change, relative " \
+           "to the deployment of the facility. The first time must be 0. Set" \
+           " it to [-1] to give the preferences of all timesteps in " \
+           "`feed_commod_prefs_vals` instead (method 2, see README)." \
+  }
+  std::vector<int> feed_commod_prefs_times;
+
+  #pragma cyclus var { \
+    "default": [], \
+    "tooltip": "time-dependent feed commodity preferences", \
+    "uilabel": "Time-dependent feed commodity preferences", \
+    "doc": "time-dependent feed commodity preferences: the preferences of " \
+           "all commodities (in the same order as in 'feed_commods') at the " \
+           "first change time, followed by the ones at the second change " \
+           "time, etc. If set, `feed_commod_prefs` is only used to check the" \
+           " number of commodities and may be omitted." \
+  }
+  std::vector<double> feed_commod_prefs_vals;
+  FlexibleVectorInput<double> flexible_feed_prefs;
   // Feed indices sorted s.t. highest preference comes first.
   std::vector<int> feed_idx_by_pref;
 
@@ -225,6 +177,70 @@ class FlexibleEnrichment : public cyclus::Facility,
   }
   double max_feed_inventory;
 
+  #pragma cyclus var { \
+    "default": 0, \
+    "tooltip": "SWU capacity lookahead of feed requests (timesteps)", \
+    "uilabel": "Feed Request Lookahead", \
+    "doc": "if positive, feed requests are sized to the SWU capacity of the " \
+           "current and the next `feed_lookahead` timesteps instead of " \
+           "filling the feed inventories up to `max_feed_inventory`: the " \
+           "facility only requests the feed it expects to enrich with this " \
+           "capacity (using the feed per SWU of its last enrichments) minus " \
+           "the feed it holds. Until the first enrichment, and if set to 0, " \
+           "the feed inventories are filled." \
+  }
+  int feed_lookahead;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "internal": True, \
+    "doc": "feed used per SWU in the last timestep with enrichments, used " \
+           "to convert the upcoming SWU capacity into feed if " \
+           "`feed_lookahead` is positive." \
+  }
+  double feed_per_swu;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "tooltip": "interval of the tails inventory compaction (timesteps)", \
+    "uilabel": "Tails Compaction Interval", \
+    "doc": "if positive, the tails materials whose compositions agree " \
+           "within `kEpsCompMap` are merged every " \
+           "`tails_compaction_interval` timesteps, counted from the " \
+           "deployment of the facility (during Tock), such that the tails " \
+           "inventory holds one material per tails composition instead of " \
+           "one per enrichment, and the number of tails materials is " \
+           "recorded in the TailsInvCount time series. Set to 0 to disable." \
+  }
+  int tails_compaction_interval;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "tooltip": "blend the feed of several feed inventories", \
+    "uilabel": "Blend Feeds", \
+    "doc": "if true, a product request that no single feed inventory can " \
+           "fulfil is enriched from several feed inventories in the order " \
+           "of their preferences, and the bids are constrained by the feed " \
+           "of all inventories together. If false, such a request is only " \
+           "partially fulfilled from the highest-preference, non-empty " \
+           "feed inventory." \
+  }
+  bool blend_feeds;
+
+  #pragma cyclus var { \
+    "default": "trade", \
+    "tooltip": "granularity of the enrichment records", \
+    "uilabel": "Record Granularity", \
+    "doc": "how the enrichments are written to the FlexibleEnrichments " \
+           "table: 'trade' writes one row per enrichment, 'timestep' one " \
+           "row per feed commodity and timestep with the summed feed and " \
+           "SWU (written during Tock), and 'off' none. The ENRICH_SWU and " \
+           "ENRICH_FEED time series are recorded in any case." \
+  }
+  std::string record_granularity;
+  // `record_granularity` as parsed in EnterNotify.
+  RecordGranularity record_granularity_;
+
   #pragma cyclus var { \
     "default": 1.0,	\
     "tooltip": "maximum allowed enrichment fraction", \
@@ -298,7 +314,78 @@ class FlexibleEnrichment : public cyclus::Facility,
            "facility (kg SWU / month). Also see `doc` of `swu_capacity_times`" \
   }
   std::vector<double> swu_capacity_vals;
+
+  #pragma cyclus var { \
+    "default": "step", \
+    "tooltip": "SWU capacity interpolation between change times", \
+    "uilabel": "SWU capacity interpolation", \
+    "doc": "how the SWU capacity is determined between the times listed in " \
+           "`swu_capacity_times`: 'step' keeps the value until the next " \
+           "change time, 'linear' interpolates linearly between the change " \
+           "times such that ramps can be defined by their end points only. " \
+           "Ignored if method 2 (see README) is used." \
+  }
+  std::string swu_capacity_interp;
+
+  #pragma cyclus var { \
+    "default": "", \
+    "tooltip": "SWU capacity schedule file", \
+    "uilabel": "SWU capacity schedule file", \
+    "doc": "file containing the SWU capacity schedule. If set, " \
+           "`swu_capacity_vals` and `swu_capacity_times` are ignored. Files " \
+           "ending in '.csv' contain either one value per timestep or " \
+           "'time,value' pairs per line, all other files contain the raw " \
+           "values (64 bit floats, native byte order) of all timesteps and " \
+           "are memory-mapped instead of being read." \
+  }
+  std::string swu_capacity_file;
+
+  #pragma cyclus var { \
+    "default": "", \
+    "tooltip": "SWU capacity formula", \
+    "uilabel": "SWU capacity formula", \
+    "doc": "formula of the relative time `t` (timesteps since the deployment" \
+           " of the facility) defining the SWU capacity, e.g., `100 * " \
+           "1.02^t` or `if(t % 12 == 11, 0, 100)`. If set, it replaces all " \
+           "other `swu_capacity_*` schedule variables. See " \
+           "`schedule_expression.h` for the syntax." \
+  }
+  std::string swu_capacity_expr;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "tooltip": "seed of random schedule functions", \
+    "uilabel": "Schedule seed", \
+    "doc": "seed of the random functions (e.g., `normal(mean, stddev)`) " \
+           "used in `swu_capacity_expr`. Together with the agent id and the " \
+           "`ensemble_member` it determines the random values, i.e., " \
+           "runs with the same seed and ensemble member are reproducible." \
+  }
+  int schedule_seed;
+
+  #pragma cyclus var { \
+    "default": -1, \
+    "tooltip": "ensemble member of random schedule functions", \
+    "uilabel": "Ensemble member", \
+    "doc": "member of an ensemble run, combined with `schedule_seed` for " \
+           "the random functions used in `swu_capacity_expr`. " \
+           "If negative, it is taken from the environment variable " \
+           "FLEXICAMORE_ENSEMBLE_MEMBER (0 if not set) when the agent " \
+           "enters the simulation and stored, such that the member used is " \
+           "recorded with the agent state." \
+  }
+  int ensemble_member;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "internal": True, \
+    "doc": "position in the SWU capacity schedule, stored such that restarted " \
+           "simulations continue from there." \
+  }
+  int swu_capacity_idx;
   FlexibleInput<double> flexible_swu;
+  // Registration of `flexible_swu` in the simulation's ScheduleRegistry.
+  ScheduleSlot<double> swu_slot_;
   // TODO check if this variable is actually needed or if it can be replaced
   // entirely by the FlexibleInput SWU variable.
   double swu_capacity;
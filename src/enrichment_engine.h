@@ -0,0 +1,969 @@
+#ifndef FLEXICAMORE_SRC_ENRICHMENT_ENGINE_H_
+#define FLEXICAMORE_SRC_ENRICHMENT_ENGINE_H_
+
+#include <algorithm>  // std::find, std::max, std::min, std::stable_sort
+#include <cstddef>  // std::size_t
+#include <map>
+#include <numeric>  // std::iota
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>  // std::pair
+#include <vector>
+
+#include "cyclus.h"
+
+#include "enrichment_memo.h"
+#include "uranium_cache.h"
+#include "uranium_tally.h"
+
+namespace flexicamore {
+
+const double kEpsCompMap = 1e-5;
+const std::size_t kMaxConverters = 1024;
+
+// The SwuConverter is a simple Converter class for material to determine the
+// amount of SWU required for their proposed enrichment.
+class SwuConverter : public cyclus::Converter<cyclus::Material> {
+ public:
+  SwuConverter(double feed_assay, double tails_assay)
+      : feed_assay(feed_assay), tails_assay(tails_assay) {}
+  virtual ~SwuConverter() {}
+
+  /// @returns the shared instance for `feed_assay` and `tails_assay`, such
+  /// that the constraints of successive bids share one converter.
+  static cyclus::Converter<cyclus::Material>::Ptr Get(double feed_assay,
+                                                      double tails_assay) {
+    typedef std::map<std::pair<double, double>,
+                     cyclus::Converter<cyclus::Material>::Ptr> Map;
+    static Map instances;
+    std::pair<double, double> key(feed_assay, tails_assay);
+    Map::const_iterator it = instances.find(key);
+    if (it != instances.end()) {
+      return it->second;
+    }
+    // Like the `UraniumCache`, drop all instances once there are too many.
+    if (instances.size() >= kMaxConverters) {
+      instances.clear();
+    }
+    cyclus::Converter<cyclus::Material>::Ptr converter(
+        new SwuConverter(feed_assay, tails_assay));
+    instances[key] = converter;
+    return converter;
+  }
+
+  /// @brief provides a conversion for the SWU required
+  virtual double convert(
+      cyclus::Material::Ptr m,
+      cyclus::Arc const * a = NULL,
+      cyclus::ExchangeTranslationContext<cyclus::Material>
+          const * ctx = NULL) const {
+    cyclus::toolkit::Assays assays(feed_assay, UraniumCache::AssayMass(m),
+                                   tails_assay);
+    return EnrichmentMemo::SwuRequired(m->quantity(), assays);
+  }
+
+  /// @returns true if Converter is a SWUConverter and feed and tails equal
+  virtual bool operator==(Converter& other) const {
+    // Interned converters are compared by address.
+    if (&other == this) {
+      return true;
+    }
+    SwuConverter* cast = dynamic_cast<SwuConverter*>(&other);
+    return cast != NULL && cyclus::AlmostEq(feed_assay, cast->feed_assay)
+           && cyclus::AlmostEq(tails_assay, cast->tails_assay);
+  }
+
+ private:
+  double feed_assay;
+  double tails_assay;
+};
+
+// The FeedConverter is a simple Converter class for material to determine the
+// amount of feed required for the proposed enrichment.
+class FeedConverter: public cyclus::Converter<cyclus::Material> {
+ public:
+  FeedConverter(double feed_assay, double tails_assay)
+      : feed_assay(feed_assay), tails_assay(tails_assay) {}
+  virtual ~FeedConverter() {}
+
+  /// @returns the shared instance for `feed_assay` and `tails_assay`, such
+  /// that the constraints of successive bids share one converter.
+  static cyclus::Converter<cyclus::Material>::Ptr Get(double feed_assay,
+                                                      double tails_assay) {
+    typedef std::map<std::pair<double, double>,
+                     cyclus::Converter<cyclus::Material>::Ptr> Map;
+    static Map instances;
+    std::pair<double, double> key(feed_assay, tails_assay);
+    Map::const_iterator it = instances.find(key);
+    if (it != instances.end()) {
+      return it->second;
+    }
+    // Like the `UraniumCache`, drop all instances once there are too many.
+    if (instances.size() >= kMaxConverters) {
+      instances.clear();
+    }
+    cyclus::Converter<cyclus::Material>::Ptr converter(
+        new FeedConverter(feed_assay, tails_assay));
+    instances[key] = converter;
+    return converter;
+  }
+
+  /// @brief provides a conversion for the amount of feed required.
+  virtual double convert(
+      cyclus::Material::Ptr m,
+      cyclus::Arc const * a = NULL,
+      cyclus::ExchangeTranslationContext<cyclus::Material>
+          const * ctx = NULL) const {
+    cyclus::toolkit::Assays assays(feed_assay, UraniumCache::AssayMass(m),
+                                   tails_assay);
+    // Combined fraction of U235 and U238 in product material `m`.
+    double uranium_frac = UraniumCache::Get(m).uranium_mass;
+    // Feed required to product `m->quantity()` of product.
+    double feed_req = EnrichmentMemo::FeedQty(m->quantity(), assays);
+    return feed_req / uranium_frac;
+  }
+
+  /// @returns true if Converter is a FeedConverter and feed and tails equal
+  virtual bool operator==(Converter& other) const {
+    // Interned converters are compared by address.
+    if (&other == this) {
+      return true;
+    }
+    FeedConverter* cast = dynamic_cast<FeedConverter*>(&other);
+    return cast != NULL && cyclus::AlmostEq(feed_assay, cast->feed_assay)
+           && cyclus::AlmostEq(tails_assay, cast->tails_assay);
+  }
+
+ private:
+  double feed_assay;
+  double tails_assay;
+};
+
+// The BlendedFeedConverter determines the U235 above the tails assay that the
+// proposed enrichment takes from the feed. Unlike the FeedConverter, it does
+// not depend on the feed assay, such that one constraint can cover all feed
+// inventories when feeds are blended (see `blend_feeds`).
+class BlendedFeedConverter : public cyclus::Converter<cyclus::Material> {
+ public:
+  explicit BlendedFeedConverter(double tails_assay)
+      : tails_assay(tails_assay) {}
+  virtual ~BlendedFeedConverter() {}
+
+  /// @returns the shared instance for `tails_assay`.
+  static cyclus::Converter<cyclus::Material>::Ptr Get(double tails_assay) {
+    typedef std::map<double, cyclus::Converter<cyclus::Material>::Ptr> Map;
+    static Map instances;
+    Map::const_iterator it = instances.find(tails_assay);
+    if (it != instances.end()) {
+      return it->second;
+    }
+    if (instances.size() >= kMaxConverters) {
+      instances.clear();
+    }
+    cyclus::Converter<cyclus::Material>::Ptr converter(
+        new BlendedFeedConverter(tails_assay));
+    instances[tails_assay] = converter;
+    return converter;
+  }
+
+  /// @brief provides the U235 above the tails assay needed for `m`.
+  virtual double convert(
+      cyclus::Material::Ptr m,
+      cyclus::Arc const * a = NULL,
+      cyclus::ExchangeTranslationContext<cyclus::Material>
+          const * ctx = NULL) const {
+    double uranium = m->quantity() * UraniumCache::Get(m).uranium_mass;
+    return uranium * (UraniumCache::AssayMass(m) - tails_assay);
+  }
+
+  /// @returns true if Converter is a BlendedFeedConverter and tails equal
+  virtual bool operator==(Converter& other) const {
+    if (&other == this) {
+      return true;
+    }
+    BlendedFeedConverter* cast = dynamic_cast<BlendedFeedConverter*>(&other);
+    return cast != NULL && cyclus::AlmostEq(tails_assay, cast->tails_assay);
+  }
+
+ private:
+  double tails_assay;
+};
+
+// Feed inventory, assays, feed, SWU and product quantity of one enrichment.
+struct EnrichmentPlan {
+  int feed_idx;
+  double feed_assay;
+  double product_assay;
+  double feed_qty;
+  double swu;
+  double product_qty;
+  double leftover_feed;  // feed left in the inventory afterwards
+};
+
+// Feed preference policies of the `EnrichmentEngine`. With
+// `AlternativeFeedPrefs`, the facility switches to alternative feed
+// preferences while it receives requests in a given enrichment interval (see
+// `PakistanEnrichment`). The policy is resolved at compile time, such that
+// facilities with `FixedFeedPrefs` do not pay for it.
+struct FixedFeedPrefs {
+  static constexpr bool kAlternative = false;
+};
+
+struct AlternativeFeedPrefs {
+  static constexpr bool kAlternative = true;
+};
+
+// How the enrichments are written to the enrichment table of an archetype:
+// one row per enrichment, one row per feed commodity and timestep, or none.
+enum class RecordGranularity { kTrade, kTimestep, kOff };
+
+// Convert the granularity name used in input files ('trade', 'timestep' or
+// 'off').
+inline RecordGranularity ParseRecordGranularity(const std::string& name) {
+  if (name == "trade") {
+    return RecordGranularity::kTrade;
+  } else if (name == "timestep") {
+    return RecordGranularity::kTimestep;
+  } else if (name == "off") {
+    return RecordGranularity::kOff;
+  }
+  std::stringstream ss;
+  ss << "Unknown record granularity '" << name << "', expected 'trade', "
+     << "'timestep' or 'off'.\n";
+  throw cyclus::ValueError(ss.str());
+}
+
+/// @class EnrichmentEngine
+///
+/// Bidding, trading and enrichment logic shared by the enrichment archetypes.
+/// The archetypes derive from the engine (CRTP) and keep their state
+/// variables, which the engine accesses as a friend. `Facility` has to
+/// provide the members used below (e.g., `feed_inv`, `feed_tally`,
+/// `tails_inv`, `feed_idx_by_pref`, `blend_feeds`, `record_granularity_`),
+/// the static log settings `kLogTag` and `kPlanLogLevel`, and
+/// `RecordEnrichment_(const EnrichmentPlan&)`, which writes one row of its
+/// enrichment table. With `AlternativeFeedPrefs`, it also has to provide
+/// `UpdateAltFeedPrefs_(out_requests)`.
+template <class Facility, class FeedPrefPolicy>
+class EnrichmentEngine {
+ protected:
+  // Bid on tails and product requests.
+  std::set<cyclus::BidPortfolio<cyclus::Material>::Ptr> GetMatlBids_(
+      cyclus::CommodMap<cyclus::Material>::type& out_requests) {
+    using cyclus::BidPortfolio;
+    using cyclus::CapacityConstraint;
+    using cyclus::Material;
+    using cyclus::Request;
+    using cyclus::toolkit::MatVec;
+    using cyclus::toolkit::RecordTimeSeries;
+
+    Facility& self = Self_();
+    std::set<BidPortfolio<Material>::Ptr> ports;
+
+    // Please note that the function below may not be entirely right. I copied
+    // this from cycamore's enrichment facility and, the way *I* understand
+    // it, is that it saves the current feed quantity as *product supply*.
+    // Clearly, this is not correct as the product supply will be smaller or
+    // much smaller than the feed quantity. I might think about a better
+    // implementation at some later point in time. (minor TODO)
+    for (int i = 0; i < self.feed_commods.size(); ++i) {
+      RecordTimeSeries<double>("supply" + self.feed_commods[i], &self,
+                               self.feed_inv[i].quantity());
+    }
+    RecordTimeSeries<double>("supply" + self.tails_commod, &self,
+                             self.tails_inv.quantity());
+
+    // Bid on tails requests if available.
+    if (out_requests.count(self.tails_commod) > 0
+        && self.tails_inv.quantity() > 0) {
+      BidPortfolio<Material>::Ptr tails_port(new BidPortfolio<Material>());
+
+      std::vector<Request<Material>*>& tails_requests =
+        out_requests[self.tails_commod];
+      // Take one snapshot of the tails materials for all requests, instead of
+      // popping and pushing the whole inventory for each request.
+      MatVec materials = self.tails_inv.PopN(self.tails_inv.count());
+      self.tails_inv.Push(materials);
+      std::vector<Request<Material>*>::iterator it;
+      for (it = tails_requests.begin(); it!= tails_requests.end(); it++) {
+        for (int k = 0; k < materials.size(); k++) {
+          tails_port->AddBid(*it, materials[k], &self);
+        }
+      }
+      CapacityConstraint<Material> tails_constraint(self.tails_inv.quantity());
+      tails_port->AddConstraint(tails_constraint);
+      LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+          << self.prototype() << " adding tails capacity constraint of "
+          << self.tails_inv.quantity();
+      ports.insert(tails_port);
+    }
+
+    if constexpr (FeedPrefPolicy::kAlternative) {
+      self.UpdateAltFeedPrefs_(out_requests);
+    }
+
+    // Bid on product requests if available. Note that one request receives
+    // at most on bid (even if multiple feed commodities were available).
+    if (out_requests.count(self.product_commod) == 0) {
+      return ports;
+    }
+    std::vector<Request<Material>*>& commod_requests =
+        out_requests[self.product_commod];
+    // Iterate through feed inventory, use only the highest-preference but
+    // non-empty inventory.
+    for (int feed_idx : self.feed_idx_by_pref) {
+      if (self.feed_inv[feed_idx].quantity() <= 0) {
+        continue;
+      }
+      BidPortfolio<Material>::Ptr commod_port(new BidPortfolio<Material>());
+      std::vector<double> product_assays;
+      std::vector<Request<Material>*>::iterator it;
+      for (it = commod_requests.begin(); it != commod_requests.end(); it++) {
+        Material::Ptr req_mat = (*it)->target();
+        if (ValidReq_(req_mat)) {
+          Material::Ptr offer = Offer_(req_mat);
+          commod_port->AddBid(*it, offer, &self);
+          product_assays.push_back(UraniumCache::AssayMass(offer));
+        }
+      }
+      if (self.blend_feeds && AddBlendedConstraints_(commod_port,
+                                                     product_assays)) {
+        ports.insert(commod_port);
+        break;
+      }
+      double feed_assay = FeedAssay_(feed_idx);
+      // The converters below are evaluated for each bid during the market
+      // resolution, hence compute their factors in one batch.
+      EnrichmentMemo::Warm(feed_assay, self.tails_assay, product_assays);
+      // Add SWU constraint.
+      CapacityConstraint<Material> swu_constraint(
+          self.swu_capacity, SwuConverter::Get(feed_assay, self.tails_assay));
+      commod_port->AddConstraint(swu_constraint);
+      LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+          << self.prototype() << " adding a SWU constraint of "
+          << swu_constraint.capacity();
+
+      // Add feed constraint.
+      CapacityConstraint<Material> feed_constraint(
+          self.feed_inv[feed_idx].quantity(),
+          FeedConverter::Get(feed_assay, self.tails_assay));
+      commod_port->AddConstraint(feed_constraint);
+      LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+          << self.prototype() << " adding a feed constraint of "
+          << feed_constraint.capacity();
+      ports.insert(commod_port);
+      break;
+    }
+    return ports;
+  }
+
+  // Serve the tails trades and enrich the product of all product trades.
+  void GetMatlTrades_(
+      const std::vector<cyclus::Trade<cyclus::Material> >& trades,
+      std::vector<std::pair<cyclus::Trade<cyclus::Material>,
+                            cyclus::Material::Ptr> >& responses) {
+    using cyclus::Material;
+
+    Facility& self = Self_();
+
+    // Serve the tails trades first. They are limited to the tails held at the
+    // time of the bidding, hence they receive the same tails as if the trades
+    // were served in order. The product trades are then enriched at once.
+    std::vector<Material::Ptr> trade_responses(trades.size());
+    std::vector<int> product_trades;
+    std::vector<Material::Ptr> product_mats;
+    std::vector<double> product_qtys;
+    for (int i = 0; i < trades.size(); ++i) {
+      double qty = trades[i].amt;
+      std::string commod_type = trades[i].bid->request()->commodity();
+      if (commod_type == self.tails_commod) {
+        LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+            << self.prototype() << " just received an order for " << qty
+            << " of " << self.tails_commod;
+        double pop_qty = std::min(qty, self.tails_inv.quantity());
+        trade_responses[i] = self.tails_inv.Pop(pop_qty, cyclus::eps_rsrc());
+      } else {
+        LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+            << self.prototype() << " just received an order for " << qty
+            << " of " << self.product_commod;
+        product_trades.push_back(i);
+        product_mats.push_back(trades[i].bid->offer());
+        product_qtys.push_back(qty);
+      }
+    }
+    if (!product_trades.empty()) {
+      std::vector<Material::Ptr> products = EnrichGroup_(product_mats,
+                                                         product_qtys);
+      for (int i = 0; i < product_trades.size(); ++i) {
+        trade_responses[product_trades[i]] = products[i];
+      }
+    }
+    for (int i = 0; i < trades.size(); ++i) {
+      responses.push_back(std::make_pair(trades[i], trade_responses[i]));
+    }
+
+    if (cyclus::IsNegative(self.tails_inv.quantity())) {
+      std::stringstream ss;
+      ss << "is being asked to provide more than its current inventory.";
+      throw cyclus::ValueError(self.InformErrorMsg(ss.str()));
+    }
+    if (cyclus::IsNegative(self.current_swu_capacity)) {
+      std::stringstream ss;
+      ss << " is being asked to provide more than its SWU capacity.";
+      throw cyclus::ValueError(self.InformErrorMsg(ss.str()));
+    }
+  }
+
+  void AcceptMatlTrades_(
+      const std::vector<std::pair<cyclus::Trade<cyclus::Material>,
+                                  cyclus::Material::Ptr> >& responses) {
+    for (int i = 0; i < responses.size(); ++i) {
+      AddMat_(responses[i].second, responses[i].first.request->commodity());
+    }
+  }
+
+  bool ValidReq_(const cyclus::Material::Ptr req_mat) {
+    UraniumFractions fractions = UraniumCache::Get(req_mat);
+    // Combined fraction of U235 and U238 in `req_mat`.
+    double uranium_frac = fractions.uranium_atom;
+
+    // Here, we assume that only the uranium gets enriched (which is a valid
+    // assumption for UF6.
+    double u235 = fractions.u235_atom / uranium_frac;
+    double u238 = fractions.u238_atom / uranium_frac;
+
+    bool u238_present = u238 > 0;
+    bool not_depleted = u235 > Self_().tails_assay;
+    bool possible_enrichment = u235 < Self_().max_enrich;
+
+    return u238_present && not_depleted && possible_enrichment;
+  }
+
+  // The offer only contains the uranium of `mat`. Its composition is cached
+  // per request composition, such that the offers of all biddings share it.
+  cyclus::Material::Ptr Offer_(cyclus::Material::Ptr mat) {
+    // Combined fraction of U235 and U238 in `mat`.
+    double uranium_frac = UraniumCache::Get(mat).uranium_mass;
+    return cyclus::Material::CreateUntracked(
+        mat->quantity() / uranium_frac, UraniumCache::UraniumComp(mat->comp()));
+  }
+
+  // U235 assay of the uranium in feed inventory `feed_idx_`, read from its
+  // `UraniumTally` in O(1).
+  double FeedAssay_(int feed_idx_) {
+    return Self_().feed_tally[feed_idx_].assay();
+  }
+
+  // Sort the indices of `pref_vec` into `idx_vec` such that the highest
+  // preference comes first.
+  void FeedIdxByPreference_(std::vector<int>& idx_vec,
+                            const std::vector<double>& pref_vec) {
+    idx_vec = std::vector<int>(pref_vec.size());
+    std::iota(idx_vec.begin(), idx_vec.end(), 0);
+    std::stable_sort(
+        idx_vec.begin(), idx_vec.end(),
+        [&](int i, int j) {return pref_vec[i] > pref_vec[j];}
+    );
+  }
+
+  // This function will probably be needed because of NU *and* LEU *and* DU
+  // *and* reprocessed U enrichment.
+  // TODO *Alternatively* I could conceive to program the enrichment s.t. it
+  // only requests fresh uranium once its stock are empty?
+  void AddFeedMat_(cyclus::Material::Ptr mat, std::string commodity) {
+    Facility& self = Self_();
+    std::vector<std::string>::iterator commod_it = std::find(
+        self.feed_commods.begin(), self.feed_commods.end(), commodity);
+    if (commod_it == self.feed_commods.end()) {
+      std::string msg = "tried to add a material to the feed inventory which "
+                        "is not a valid commodity!";
+      throw cyclus::ValueError(msg);
+    }
+    int push_idx = commod_it - self.feed_commods.begin();
+
+    // Push the material to the correct feed inventory.
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << self.prototype() << " is initially holding "
+        << self.feed_inv[push_idx].quantity() << " of feed (commodity: "
+        << commodity << ") in inventory no. " << push_idx << ".";
+    try {
+      self.feed_inv[push_idx].Push(mat);
+      self.feed_tally[push_idx].Add(mat);
+    } catch (cyclus::Error& e) {
+      e.msg(self.InformErrorMsg(e.msg()));
+      throw e;
+    }
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << self.prototype() << " added " << mat->quantity()
+        << " of feed commodity '" << commodity << "' to its inventory no. "
+        << push_idx << " which is now holding "
+        << self.feed_inv[push_idx].quantity();
+  }
+
+  void AddMat_(cyclus::Material::Ptr mat, std::string commodity) {
+    cyclus::CompMap cm = mat->comp()->atom();
+    bool minor_uranium_isotopes = false;
+    bool non_uranium_elements = false;
+
+    cyclus::CompMap::const_iterator it;
+    for (it = cm.begin(); it != cm.end(); it++) {
+      if (pyne::nucname::znum(it->first) == 92) {
+        if (pyne::nucname::anum(it->first) != 235 &&
+            pyne::nucname::anum(it->first) != 238 && it->second > 0) {
+          minor_uranium_isotopes = true;
+        }
+      } else if (it->second > 0) {
+        non_uranium_elements = true;
+      }
+    }
+    if (minor_uranium_isotopes) {
+      cyclus::Warn<cyclus::VALUE_WARNING>(
+          "Minor uranium isotopes (i.e., other than U235 and U238) present. "
+          "They are sent directly to tails.");
+    }
+    if (non_uranium_elements) {
+      cyclus::Warn<cyclus::VALUE_WARNING>(
+          "Non-uranium elements present. They are sent directly to tails.");
+    }
+    AddFeedMat_(mat, commodity);
+  }
+
+  // Merge the tails materials with compositions within `kEpsCompMap` of each
+  // other.
+  void CompactTails_() {
+    using cyclus::Material;
+    using cyclus::toolkit::MatVec;
+
+    Facility& self = Self_();
+    int count = self.tails_inv.count();
+    MatVec materials = self.tails_inv.PopN(count);
+    MatVec merged;
+    for (int i = 0; i < materials.size(); ++i) {
+      Material::Ptr mat = materials[i];
+      bool absorbed = false;
+      for (int j = 0; j < merged.size(); ++j) {
+        if (merged[j]->comp() == mat->comp()
+            || cyclus::compmath::AlmostEq(merged[j]->comp()->mass(),
+                                          mat->comp()->mass(), kEpsCompMap)) {
+          merged[j]->Absorb(mat);
+          absorbed = true;
+          break;
+        }
+      }
+      if (!absorbed) {
+        merged.push_back(mat);
+      }
+    }
+    self.tails_inv.Push(merged);
+    LOG(cyclus::LEV_DEBUG2, Facility::kLogTag)
+        << self.prototype() << " compacted " << count
+        << " tails materials into " << merged.size();
+  }
+
+  // Enrich `qty` of product with the composition of `mat`.
+  cyclus::Material::Ptr Enrich_(cyclus::Material::Ptr mat, double qty) {
+    return EnrichGroup_(std::vector<cyclus::Material::Ptr>(1, mat),
+                        std::vector<double>(1, qty))[0];
+  }
+
+  // Determine the enrichment(s) of `mat` given the feed `feed_avail` still
+  // available in each inventory. The highest-preference inventory that can
+  // provide all of the feed is used. If there is none, the product is taken
+  // from all non-empty inventories in preference order with `blend_feeds`,
+  // else from the highest-preference, non-empty inventory only, which yields
+  // less product than requested. One plan is returned per feed inventory.
+  std::vector<EnrichmentPlan> PlanEnrichment_(
+      cyclus::Material::Ptr mat, double request_qty,
+      const std::vector<double>& feed_avail) {
+    Facility& self = Self_();
+    int feed_used_idx = -1;  // Index of feed inventory that is to be used.
+    double product_assay = UraniumCache::AssayMass(mat);
+    // Move through the feed inventories by preference to find an inventory
+    // able to perform the enrichment.
+    for (int feed_idx : self.feed_idx_by_pref) {
+      double feed_inv_qty = feed_avail[feed_idx];
+      if (feed_inv_qty < cyclus::eps_rsrc()) {
+        continue;
+      }
+      LOG(Facility::kPlanLogLevel, Facility::kLogTag)
+          << "Considering feed commod " << self.feed_commods[feed_idx];
+      WarmFeed_(feed_idx);
+      cyclus::toolkit::Assays assays(FeedAssay_(feed_idx), product_assay,
+                                     self.tails_assay);
+      double uranium_required = EnrichmentMemo::FeedQty(request_qty, assays);
+
+      // Try to find another inventory with sufficient uranium.
+      if (feed_inv_qty < uranium_required
+          && !cyclus::AlmostEq(feed_inv_qty, uranium_required)) {
+        LOG(Facility::kPlanLogLevel, Facility::kLogTag)
+            << "Not enough " << self.feed_commods[feed_idx]
+            << " present. Feed present: " << feed_inv_qty
+            << ". Feed needed: " << uranium_required << ".";
+        continue;
+      }
+      LOG(Facility::kPlanLogLevel, Facility::kLogTag)
+          << "using feed commod " << self.feed_commods[feed_idx];
+      feed_used_idx = feed_idx;
+      break;
+    }
+
+    // Blend the feed of all inventories that can produce the product.
+    if (feed_used_idx == -1 && self.blend_feeds) {
+      std::vector<EnrichmentPlan> plans;
+      double remaining_qty = request_qty;
+      for (int feed_idx : self.feed_idx_by_pref) {
+        if (remaining_qty < cyclus::eps_rsrc()) {
+          break;
+        }
+        if (feed_avail[feed_idx] < cyclus::eps_rsrc()
+            || FeedAssay_(feed_idx) <= self.tails_assay) {
+          continue;
+        }
+        LOG(Facility::kPlanLogLevel, Facility::kLogTag)
+            << "blending " << self.feed_commods[feed_idx];
+        plans.push_back(PlanFeed_(feed_idx, product_assay, remaining_qty,
+                                  feed_avail[feed_idx]));
+        remaining_qty -= plans.back().product_qty;
+      }
+      if (!plans.empty()) {
+        return plans;
+      }
+    }
+
+    // Use the highest-preference, non-empty inventory.
+    if (feed_used_idx == -1) {
+      for (int feed_idx : self.feed_idx_by_pref) {
+        if (feed_avail[feed_idx] > cyclus::eps_rsrc()) {
+          LOG(Facility::kPlanLogLevel, Facility::kLogTag)
+              << "fallback to " << self.feed_commods[feed_idx];
+          feed_used_idx = feed_idx;
+          break;
+        }
+      }
+    }
+    if (feed_used_idx == -1) {
+      std::string msg(" has no valid feed inventory for the enrichment.");
+      throw cyclus::ValueError(self.InformErrorMsg(msg));
+    }
+    return std::vector<EnrichmentPlan>(
+        1, PlanFeed_(feed_used_idx, product_assay, request_qty,
+                     feed_avail[feed_used_idx]));
+  }
+
+  // Plan the enrichment of `request_qty` of product from feed inventory
+  // `feed_idx` holding `pop_qty` of feed. If the feed does not suffice, all
+  // of it is used and less product is produced.
+  EnrichmentPlan PlanFeed_(int feed_idx, double product_assay,
+                           double request_qty, double pop_qty) {
+    Facility& self = Self_();
+    WarmFeed_(feed_idx);
+    double feed_assay = FeedAssay_(feed_idx);
+    cyclus::toolkit::Assays assays(feed_assay, product_assay,
+                                   self.tails_assay);
+    double swu_required = EnrichmentMemo::SwuRequired(request_qty, assays);
+    double uranium_required = EnrichmentMemo::FeedQty(request_qty, assays);
+    // Determine the amount of uranium in the feed material, i.e.,
+    // U235+U238 / total mass.
+    double uranium_frac = self.feed_tally[feed_idx].uranium_frac();
+    double feed_required = uranium_required / uranium_frac;
+    // Special case: the feed does not suffice.
+    if (feed_required > pop_qty) {
+      // All of the available feed is to be used.
+      feed_required = pop_qty;
+
+      // Amount of U235 and U238 in the available feed.
+      double u235_u238_available = pop_qty * uranium_frac;
+      double factor = (assays.Product() - assays.Tails())
+                      / (assays.Feed() - assays.Tails());
+      // Reevaluate how much product can be produced.
+      request_qty = u235_u238_available / factor;
+
+      // The SWU needs to be recalculated as well because all non-U235 and
+      // non-U238 elements/isotopes are directly sent to the tails and do
+      // not contribute to the SWU.
+      swu_required = EnrichmentMemo::SwuRequired(request_qty, assays);
+    }
+
+    EnrichmentPlan plan;
+    plan.feed_idx = feed_idx;
+    plan.feed_assay = feed_assay;
+    plan.product_assay = product_assay;
+    plan.feed_qty = feed_required;
+    plan.swu = swu_required;
+    plan.product_qty = request_qty;
+    plan.leftover_feed = std::max(0., pop_qty - feed_required);
+    return plan;
+  }
+
+  // Perform the enrichments of `mats` as if `Enrich_` was called for each of
+  // them in order, but pop the feed only once per feed inventory.
+  std::vector<cyclus::Material::Ptr> EnrichGroup_(
+      const std::vector<cyclus::Material::Ptr>& mats,
+      const std::vector<double>& request_qtys) {
+    using cyclus::Material;
+
+    Facility& self = Self_();
+    std::vector<cyclus::toolkit::ResBuf<Material> >& feed_inv = self.feed_inv;
+
+    // Plan the enrichments one after the other as if they were performed
+    // separately, such that each one uses the same feed inventory, feed and
+    // SWU as it would on its own.
+    std::vector<double> feed_avail(feed_inv.size());
+    for (int i = 0; i < feed_inv.size(); ++i) {
+      feed_avail[i] = feed_inv[i].quantity();
+    }
+    // The SWU and feed factors of all enrichments are computed in one batch
+    // per feed, once the planning first considers the feed, see `WarmFeed_`.
+    warm_product_assays_.clear();
+    for (int i = 0; i < mats.size(); ++i) {
+      warm_product_assays_.push_back(UraniumCache::AssayMass(mats[i]));
+    }
+    feed_warmed_.assign(feed_inv.size(), false);
+    std::vector<std::vector<EnrichmentPlan> > plans;
+    std::vector<double> feed_pop(feed_inv.size(), 0.);
+    std::vector<bool> feed_used(feed_inv.size(), false);
+    for (int i = 0; i < mats.size(); ++i) {
+      plans.push_back(PlanEnrichment_(mats[i], request_qtys[i], feed_avail));
+      for (const EnrichmentPlan& plan : plans.back()) {
+        feed_avail[plan.feed_idx] = plan.leftover_feed;
+        feed_pop[plan.feed_idx] += plan.feed_qty;
+        feed_used[plan.feed_idx] = true;
+      }
+    }
+    feed_warmed_.clear();
+
+    // Pop the feed of all enrichments at once from each inventory used. The
+    // inventory is squashed first such that the feed has the average
+    // composition used in the plans.
+    std::vector<Material::Ptr> pop_mats(feed_inv.size());
+    for (int i = 0; i < feed_inv.size(); ++i) {
+      if (!feed_used[i]) {
+        continue;
+      }
+      try {
+        Material::Ptr feed_mat = cyclus::toolkit::Squash(
+            feed_inv[i].PopN(feed_inv[i].count()));
+        if (cyclus::AlmostEq(feed_pop[i], feed_mat->quantity())) {
+          pop_mats[i] = feed_mat;
+          self.feed_tally[i].Reset(NULL);
+        } else {
+          pop_mats[i] = feed_mat->ExtractQty(feed_pop[i]);
+          feed_inv[i].Push(feed_mat);
+          self.feed_tally[i].Reset(feed_mat);
+        }
+      } catch (cyclus::Error& e) {
+        std::stringstream ss;
+        ss << " tried to remove " << feed_pop[i] << " from its feed "
+           << "inventory nr " << i << " holding " << feed_inv[i].quantity()
+           << " for " << mats.size() << " enrichment(s): " << e.what();
+        throw cyclus::ValueError(self.InformErrorMsg(ss.str()));
+      }
+    }
+
+    // Convert the popped feed into the products, the rest becomes the tails.
+    // The product of each composition is extracted at once from each feed
+    // and then split among the enrichments. The products of a blended
+    // enrichment are combined into one material.
+    typedef std::pair<int, int> ProductKey;  // feed index and composition id
+    std::map<ProductKey, double> product_qty;
+    std::map<ProductKey, int> product_count;
+    for (int i = 0; i < plans.size(); ++i) {
+      for (const EnrichmentPlan& plan : plans[i]) {
+        ProductKey key(plan.feed_idx, mats[i]->comp()->id());
+        product_qty[key] += plan.product_qty;
+        ++product_count[key];
+      }
+    }
+    std::map<ProductKey, Material::Ptr> products;
+    std::vector<Material::Ptr> responses;
+    for (int i = 0; i < plans.size(); ++i) {
+      Material::Ptr response;
+      for (const EnrichmentPlan& plan : plans[i]) {
+        ProductKey key(plan.feed_idx, mats[i]->comp()->id());
+        if (products.count(key) == 0) {
+          products[key] = pop_mats[plan.feed_idx]->ExtractComp(
+              product_qty[key], mats[i]->comp());
+        }
+        Material::Ptr product;
+        if (--product_count[key] == 0) {
+          product = products[key];
+        } else {
+          product = products[key]->ExtractQty(plan.product_qty);
+        }
+        if (response == NULL) {
+          response = product;
+        } else {
+          response->Absorb(product);
+        }
+
+        self.current_swu_capacity -= plan.swu;
+        self.intra_timestep_swu += plan.swu;
+        self.intra_timestep_feed[plan.feed_idx] += plan.feed_qty;
+        RecordPlan_(plan);
+        LogEnrichment_(plan);
+      }
+      responses.push_back(response);
+    }
+    for (int i = 0; i < pop_mats.size(); ++i) {
+      if (pop_mats[i] != NULL) {
+        self.tails_inv.Push(pop_mats[i]);
+      }
+    }
+    return responses;
+  }
+
+  // Record `plan` right away or buffer it until the end of the timestep,
+  // depending on the record granularity.
+  void RecordPlan_(const EnrichmentPlan& plan) {
+    Facility& self = Self_();
+    switch (self.record_granularity_) {
+      case RecordGranularity::kTrade:
+        self.RecordEnrichment_(plan);
+        break;
+      case RecordGranularity::kTimestep: {
+        std::map<int, EnrichmentPlan>::iterator it =
+            record_buffer_.find(plan.feed_idx);
+        if (it == record_buffer_.end()) {
+          record_buffer_[plan.feed_idx] = plan;
+          break;
+        }
+        // Sum up the quantities, the assays are averaged by mass. The plans
+        // arrive in the order they are applied, so the leftover feed of the
+        // latest one is the one at the end of the timestep.
+        EnrichmentPlan& sum = it->second;
+        double product_qty = sum.product_qty + plan.product_qty;
+        if (product_qty > 0) {
+          sum.product_assay = (sum.product_assay * sum.product_qty
+                               + plan.product_assay * plan.product_qty)
+                              / product_qty;
+        }
+        double feed_qty = sum.feed_qty + plan.feed_qty;
+        if (feed_qty > 0) {
+          sum.feed_assay = (sum.feed_assay * sum.feed_qty
+                            + plan.feed_assay * plan.feed_qty) / feed_qty;
+        }
+        sum.feed_qty = feed_qty;
+        sum.swu += plan.swu;
+        sum.product_qty = product_qty;
+        sum.leftover_feed = plan.leftover_feed;
+        break;
+      }
+      case RecordGranularity::kOff:
+        break;
+    }
+  }
+
+  // Record the enrichments buffered during the timestep, one row per feed
+  // inventory. To be called in `Tock`.
+  void FlushEnrichmentRecords_() {
+    std::map<int, EnrichmentPlan>::const_iterator it;
+    for (it = record_buffer_.begin(); it != record_buffer_.end(); ++it) {
+      Self_().RecordEnrichment_(it->second);
+    }
+    record_buffer_.clear();
+  }
+
+  // Add the SWU and feed constraints of a portfolio whose bids may blend the
+  // feed of all inventories. The feed constraint limits the U235 above the
+  // tails assay that is taken from all inventories together, which is exact
+  // for any split of the product among the feeds. The SWU per product is the
+  // one of the lowest feed assay, such that the SWU capacity is never
+  // exceeded. Returns false if no inventory can produce any product.
+  bool AddBlendedConstraints_(
+      cyclus::BidPortfolio<cyclus::Material>::Ptr port,
+      const std::vector<double>& product_assays) {
+    using cyclus::CapacityConstraint;
+    using cyclus::Material;
+
+    Facility& self = Self_();
+    double min_feed_assay = 1;
+    double excess_u235 = 0;
+    for (int i = 0; i < self.feed_inv.size(); ++i) {
+      double feed_assay = FeedAssay_(i);
+      if (self.feed_inv[i].quantity() <= 0
+          || feed_assay <= self.tails_assay) {
+        continue;
+      }
+      EnrichmentMemo::Warm(feed_assay, self.tails_assay, product_assays);
+      min_feed_assay = std::min(min_feed_assay, feed_assay);
+      excess_u235 += self.feed_inv[i].quantity()
+                     * self.feed_tally[i].uranium_frac()
+                     * (feed_assay - self.tails_assay);
+    }
+    if (excess_u235 <= 0) {
+      return false;
+    }
+    CapacityConstraint<Material> swu_constraint(
+        self.swu_capacity, SwuConverter::Get(min_feed_assay,
+                                             self.tails_assay));
+    port->AddConstraint(swu_constraint);
+    CapacityConstraint<Material> feed_constraint(
+        excess_u235, BlendedFeedConverter::Get(self.tails_assay));
+    port->AddConstraint(feed_constraint);
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << self.prototype() << " adding a SWU constraint of "
+        << swu_constraint.capacity() << " and a blended feed constraint of "
+        << feed_constraint.capacity();
+    return true;
+  }
+
+ private:
+  inline Facility& Self_() { return static_cast<Facility&>(*this); }
+
+  // Enrichments of the current timestep summed up per feed inventory if the
+  // records are written per timestep. Flushed in every `Tock`, hence it is
+  // not part of the facility's state.
+  std::map<int, EnrichmentPlan> record_buffer_;
+
+  // Product assays of the enrichments planned by `EnrichGroup_` and the feed
+  // inventories whose factors have been computed for them. Only used during
+  // the planning, hence not part of the facility's state either.
+  std::vector<double> warm_product_assays_;
+  std::vector<bool> feed_warmed_;
+
+  // Compute the SWU and feed factors of feed inventory `feed_idx` for all
+  // enrichments of the group being planned, unless done already. Feeds that
+  // the planning never considers are not computed.
+  void WarmFeed_(int feed_idx) {
+    if (feed_idx >= feed_warmed_.size() || feed_warmed_[feed_idx]) {
+      return;
+    }
+    feed_warmed_[feed_idx] = true;
+    EnrichmentMemo::Warm(FeedAssay_(feed_idx), Self_().tails_assay,
+                         warm_product_assays_);
+  }
+
+  void LogEnrichment_(const EnrichmentPlan& plan) {
+    Facility& self = Self_();
+    cyclus::toolkit::Assays assays(plan.feed_assay, plan.product_assay,
+                                   self.tails_assay);
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << self.prototype() << " has performed an enrichment:";
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << "   * Feed Qty: " << plan.feed_qty;
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << "   * Feed Commod.: " << self.feed_commods[plan.feed_idx];
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << "   * Feed Inv No.: " << plan.feed_idx;
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << "   * Feed Assay: " << assays.Feed() * 100 << "%";
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << "   * Product Qty: " << plan.product_qty;
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << "   * Product Assay: " << assays.Product() * 100 << "%";
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << "   * Tails Qty: "
+        << cyclus::toolkit::TailsQty(plan.product_qty, assays);
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << "   * Tails Assay: " << assays.Tails() * 100 << "%";
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << "   * SWU: " << plan.swu;
+    LOG(cyclus::LEV_INFO5, Facility::kLogTag)
+        << "   * Current SWU capacity: " << self.current_swu_capacity;
+  }
+};
+
+}  // namespace flexicamore
+
+#endif  // FLEXICAMORE_SRC_ENRICHMENT_ENGINE_H_
@@ -0,0 +1,171 @@
+#ifndef FLEXICAMORE_SRC_ENRICHMENT_MEMO_H_
+#define FLEXICAMORE_SRC_ENRICHMENT_MEMO_H_
+
+#include <cmath>  // std::llround
+#include <cstddef>  // std::size_t
+#include <functional>  // std::hash
+#include <unordered_map>
+#include <vector>
+
+#include "cyclus.h"
+
+#include "separative_work.h"
+
+namespace flexicamore {
+
+// SWU and feed required per kg of product for one (feed, product, tails)
+// assay triple.
+struct EnrichmentFactors {
+  double swu;
+  double feed;
+};
+
+// Per-process memo of the `EnrichmentFactors`.
+//
+// `cyclus::toolkit::SwuRequired` evaluates three logarithms per call, and the
+// converters are called for every arc during each market resolution and
+// again by `Enrich_` for each trade. As both SWU and feed are linear in the
+// product quantity and the assay triples repeat constantly, the per-kg
+// factors are computed once per triple.
+//
+// Assays are quantised to multiples of `kQuantum` and the factors are
+// computed from the quantised assays, such that triples differing only by
+// rounding errors share one entry and results do not depend on which of them
+// was seen first (up to the last bits if the entry was computed by the
+// vectorised `Warm`). Like the `UraniumCache`, the memo is emptied once it
+// holds `kMaxSize` triples.
+class EnrichmentMemo {
+ public:
+  static constexpr double kQuantum = 1e-12;
+  static constexpr std::size_t kMaxSize = 4096;
+
+  static EnrichmentFactors Get(const cyclus::toolkit::Assays& assays) {
+    Key key = {Quantise_(assays.Feed()), Quantise_(assays.Product()),
+               Quantise_(assays.Tails())};
+    Map& memo = Memo_();
+    Map::const_iterator it = memo.find(key);
+    if (it != memo.end()) {
+      ++Counters_()[0];
+      return it->second;
+    }
+    ++Counters_()[1];
+    if (memo.size() >= kMaxSize) {
+      memo.clear();
+    }
+    cyclus::toolkit::Assays quantised(key.feed * kQuantum,
+                                      key.product * kQuantum,
+                                      key.tails * kQuantum);
+    EnrichmentFactors factors;
+    factors.swu = cyclus::toolkit::SwuRequired(1., quantised);
+    factors.feed = cyclus::toolkit::FeedQty(1., quantised);
+    memo[key] = factors;
+    return factors;
+  }
+
+  // Compute the factors of all (feed, product, tails) triples with the given
+  // product assays that are not memoised yet in one `SwuFeedBatch` call.
+  // Used before bids or trades are evaluated in bulk: the converters are
+  // called one arc at a time by the exchange, such that the logarithms could
+  // not be vectorised otherwise. Invalid assays are skipped, they are
+  // reported by `Get` if they are ever used.
+  static void Warm(double feed_assay, double tails_assay,
+                   const std::vector<double>& product_assays) {
+    double feed = Quantise_(feed_assay) * kQuantum;
+    double tails = Quantise_(tails_assay) * kQuantum;
+    if (!(tails > 0 && tails < feed && feed < 1)) {
+      return;
+    }
+    Map& memo = Memo_();
+    std::vector<Key> keys;
+    std::vector<double> assays;
+    for (double product_assay : product_assays) {
+      Key key = {Quantise_(feed_assay), Quantise_(product_assay),
+                 Quantise_(tails_assay)};
+      double product = key.product * kQuantum;
+      if (product > 0 && product < 1 && memo.count(key) == 0) {
+        keys.push_back(key);
+        assays.push_back(product);
+      }
+    }
+    if (keys.empty()) {
+      return;
+    }
+    if (memo.size() + keys.size() > kMaxSize) {
+      memo.clear();
+    }
+    std::vector<double> qtys(assays.size(), 1.);
+    std::vector<double> swu(assays.size());
+    std::vector<double> feed_qty(assays.size());
+    SwuFeedBatch(feed, tails, assays.size(), &assays[0], &qtys[0], &swu[0],
+                 &feed_qty[0]);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      EnrichmentFactors factors;
+      factors.swu = swu[i];
+      factors.feed = feed_qty[i];
+      memo[keys[i]] = factors;
+    }
+  }
+
+  // Drop-in replacements of the `cyclus::toolkit` functions.
+  static inline double SwuRequired(double product_qty,
+                                   const cyclus::toolkit::Assays& assays) {
+    return product_qty * Get(assays).swu;
+  }
+  static inline double FeedQty(double product_qty,
+                               const cyclus::toolkit::Assays& assays) {
+    return product_qty * Get(assays).feed;
+  }
+
+  // Number of lookups served from the memo and computed, for profiling.
+  static inline std::size_t hits() { return Counters_()[0]; }
+  static inline std::size_t misses() { return Counters_()[1]; }
+  static inline std::size_t size() { return Memo_().size(); }
+  static void ResetCounters() {
+    Counters_()[0] = 0;
+    Counters_()[1] = 0;
+  }
+
+ private:
+  struct Key {
+    long long feed;
+    long long product;
+    long long tails;
+
+    bool operator==(const Key& other) const {
+      return feed == other.feed && product == other.product
+             && tails == other.tails;
+    }
+  };
+
+  struct KeyHash {
+    std::size_t operator()(const Key& key) const {
+      // Combine the hashes as done in boost::hash_combine.
+      std::hash<long long> hash;
+      std::size_t seed = hash(key.feed);
+      seed ^= hash(key.product) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+      seed ^= hash(key.tails) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+      return seed;
+    }
+  };
+
+  typedef std::unordered_map<Key, EnrichmentFactors, KeyHash> Map;
+
+  static inline long long Quantise_(double assay) {
+    return std::llround(assay / kQuantum);
+  }
+
+  static Map& Memo_() {
+    static Map memo;
+    return memo;
+  }
+
+  // Hits and misses.
+  static std::size_t* Counters_() {
+    static std::size_t counters[2] = {0, 0};
+    return counters;
+  }
+};
+
+}  // namespace flexicamore
+
+#endif  // FLEXICAMORE_SRC_ENRICHMENT_MEMO_H_
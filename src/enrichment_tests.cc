@@ -1,5 +1,7 @@
 #include "enrichment_tests.h"
 
+#include <chrono>
+#include <iostream>
 #include <set>
 
 #include "agent_tests.h"
@@ -224,6 +226,484 @@ TEST_F(FlexibleEnrichmentTest, Enrich) {
   EXPECT_NEAR(38.31507305+13.32871459, DoIntraTimestepSWU(), 1e-8);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, ResetIntraTimestep) {
+  // The usage of a timestep is reset at its beginning, such that a timestep
+  // without trades does not report the usage of the previous one.
+  using cyclus::Material;
+
+  Material::Ptr product = Material::CreateUntracked(1.,
+                                                    test::HighlyEnrichedU());
+  DoAddFeedMat(Material::CreateUntracked(inv_size, test::NaturalU()),
+               feed_commods[0]);
+  ASSERT_NO_THROW(DoEnrich(product, 1.));
+  EXPECT_NEAR(38.31507305, DoIntraTimestepSWU(), 1e-8);
+
+  flex_enrich_facility->Tick();
+  EXPECT_DOUBLE_EQ(0., DoIntraTimestepSWU());
+  std::vector<cyclus::Trade<Material> > trades;
+  std::vector<std::pair<cyclus::Trade<Material>, Material::Ptr> > responses;
+  flex_enrich_facility->GetMatlTrades(trades, responses);
+  EXPECT_TRUE(responses.empty());
+  EXPECT_DOUBLE_EQ(0., DoIntraTimestepSWU());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, EnrichGroup) {
+  // Enriching several products at once yields the same products, feed, SWU
+  // and tails as enriching them one after the other. The last enrichment
+  // exceeds the remaining feed.
+  using cyclus::Material;
+
+  std::vector<Material::Ptr> mats = {
+      Material::CreateUntracked(10, test::LowEnrichedU()),
+      Material::CreateUntracked(2, test::HighlyEnrichedU()),
+      Material::CreateUntracked(5, test::LowEnrichedU()),
+      Material::CreateUntracked(1, test::WeapongradeU()),
+      Material::CreateUntracked(3, test::HighlyEnrichedU()),
+      Material::CreateUntracked(3, test::WeapongradeU())};
+  std::vector<double> qtys;
+  for (Material::Ptr mat : mats) {
+    qtys.push_back(mat->quantity());
+  }
+
+  DoAddFeedMat(Material::CreateUntracked(inv_size, test::NaturalU()),
+               feed_commods[0]);
+  std::vector<Material::Ptr> group = DoEnrichGroup(mats, qtys);
+  ASSERT_EQ(mats.size(), group.size());
+  double group_swu = DoIntraTimestepSWU();
+  double group_feed = DoFeedQty(0);
+  double group_tails = DoTailsInv().quantity();
+
+  FlexibleEnrichment* group_facility = flex_enrich_facility;
+  flex_enrich_facility = new FlexibleEnrichment(fake_sim->context());
+  SetUpFlexibleEnrichment();
+  DoAddFeedMat(Material::CreateUntracked(inv_size, test::NaturalU()),
+               feed_commods[0]);
+  for (int i = 0; i < mats.size(); ++i) {
+    Material::Ptr single = DoEnrich(mats[i], qtys[i]);
+    EXPECT_NEAR(single->quantity(), group[i]->quantity(), 1e-9);
+    EXPECT_NEAR(UraniumCache::AssayMass(single),
+                UraniumCache::AssayMass(group[i]), 1e-12);
+  }
+  EXPECT_LT(group.back()->quantity(), qtys.back());
+  EXPECT_NEAR(DoIntraTimestepSWU(), group_swu, 1e-9 * group_swu);
+  EXPECT_NEAR(DoFeedQty(0), group_feed, 1e-9);
+  EXPECT_NEAR(DoTailsInv().quantity(), group_tails, 1e-9);
+
+  delete flex_enrich_facility;
+  flex_enrich_facility = group_facility;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, BlendFeeds) {
+  // Neither feed inventory alone can provide the feed of the product. With
+  // `blend_feeds`, the preferred LEU is used up first and the rest of the
+  // product is enriched from NU. The SWU is the one of both enrichments.
+  using cyclus::Material;
+  using cyclus::toolkit::Assays;
+
+  double product_qty = 3;
+  double leu_qty = 10;
+  Material::Ptr product = Material::CreateUntracked(product_qty,
+                                                    test::HighlyEnrichedU());
+  Assays leu_assays(0.03, 0.2, tails_assay);
+  Assays nu_assays(0.00711, 0.2, tails_assay);
+  double leu_product = leu_qty * (0.03 - tails_assay) / (0.2 - tails_assay);
+  double nu_product = product_qty - leu_product;
+
+  // Without blending, only the LEU is used.
+  DoAddFeedMat(Material::CreateUntracked(inv_size, test::NaturalU()),
+               feed_commods[0]);
+  DoAddFeedMat(Material::CreateUntracked(leu_qty, test::LowEnrichedU()),
+               feed_commods[1]);
+  Material::Ptr response = DoEnrich(product, product_qty);
+  EXPECT_NEAR(leu_product, response->quantity(), 1e-8);
+  EXPECT_NEAR(inv_size, DoFeedQty(0), 1e-8);
+  EXPECT_NEAR(0, DoFeedQty(1), 1e-8);
+
+  delete flex_enrich_facility;
+  flex_enrich_facility = new FlexibleEnrichment(fake_sim->context());
+  SetUpFlexibleEnrichment();
+  DoSetBlendFeeds(true);
+  DoAddFeedMat(Material::CreateUntracked(inv_size, test::NaturalU()),
+               feed_commods[0]);
+  DoAddFeedMat(Material::CreateUntracked(leu_qty, test::LowEnrichedU()),
+               feed_commods[1]);
+  response = DoEnrich(product, product_qty);
+  EXPECT_NEAR(product_qty, response->quantity(), 1e-8);
+  EXPECT_NEAR(0.2, UraniumCache::AssayMass(response), 1e-10);
+  EXPECT_NEAR(0, DoFeedQty(1), 1e-8);
+  EXPECT_NEAR(inv_size - cyclus::toolkit::FeedQty(nu_product, nu_assays),
+              DoFeedQty(0), 1e-8);
+  double swu = cyclus::toolkit::SwuRequired(leu_product, leu_assays)
+               + cyclus::toolkit::SwuRequired(nu_product, nu_assays);
+  EXPECT_NEAR(swu, DoIntraTimestepSWU(), 1e-8);
+  EXPECT_NEAR(inv_size + leu_qty - product_qty, DoFeedQty(0)
+              + DoTailsInv().quantity(), 1e-8);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, FeedAssay) {
+  // The feed assay is tracked while material is added to and removed from
+  // the feed inventories.
+  using cyclus::Material;
+
+  EXPECT_DOUBLE_EQ(0, DoFeedAssay(0));
+  DoAddFeedMat(Material::CreateUntracked(300, test::NaturalU()),
+               feed_commods[0]);
+  EXPECT_NEAR(0.00711, DoFeedAssay(0), 1e-12);
+  DoAddFeedMat(Material::CreateUntracked(200, test::LowEnrichedU()),
+               feed_commods[0]);
+  double mixed_assay = (300 * 0.00711 + 200 * 0.03) / 500;
+  EXPECT_NEAR(mixed_assay, DoFeedAssay(0), 1e-12);
+  EXPECT_DOUBLE_EQ(0, DoFeedAssay(1));
+
+  // The enrichment uses the squashed feed, hence the assay stays the same.
+  Material::Ptr product = Material::CreateUntracked(1,
+                                                    test::HighlyEnrichedU());
+  DoEnrich(product, product->quantity());
+  EXPECT_GT(500, DoFeedQty(0));
+  EXPECT_NEAR(mixed_assay, DoFeedAssay(0), 1e-12);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, UraniumCache) {
+  // The cached fractions equal the ones of `MatQuery`, also for materials
+  // containing other nuclides than U235 and U238.
+  cyclus::CompMap cm;
+  cm[922350000] = 0.02;
+  cm[922380000] = 0.65;
+  cm[90190000] = 0.33;
+  cyclus::Material::Ptr mat = cyclus::Material::CreateUntracked(
+      5, cyclus::Composition::CreateFromMass(cm));
+  cyclus::toolkit::MatQuery mq(mat);
+  std::set<cyclus::Nuc> nucs;
+  nucs.insert(922350000);
+  nucs.insert(922380000);
+
+  for (int i = 0; i < 2; ++i) {
+    UraniumFractions fractions = UraniumCache::Get(mat);
+    EXPECT_NEAR(mq.mass_frac(922350000), fractions.u235_mass, 1e-12);
+    EXPECT_NEAR(mq.mass_frac(922380000), fractions.u238_mass, 1e-12);
+    EXPECT_NEAR(mq.mass_frac(nucs), fractions.uranium_mass, 1e-12);
+    EXPECT_NEAR(mq.atom_frac(922350000), fractions.u235_atom, 1e-12);
+    EXPECT_NEAR(mq.atom_frac(922380000), fractions.u238_atom, 1e-12);
+    EXPECT_NEAR(mq.atom_frac(nucs), fractions.uranium_atom, 1e-12);
+    EXPECT_NEAR(cyclus::toolkit::UraniumAssayMass(mat),
+                UraniumCache::AssayMass(mat), 1e-12);
+  }
+  EXPECT_EQ(0, UraniumCache::AssayMass(cyclus::Material::CreateUntracked(
+      0, test::NaturalU())));
+
+  // The cache is bounded.
+  for (std::size_t i = 0; i < UraniumCache::kMaxSize + 10; ++i) {
+    UraniumCache::Get(cyclus::Composition::CreateFromMass(cm));
+  }
+  EXPECT_GE(UraniumCache::kMaxSize, UraniumCache::size());
+
+  // The uranium-only composition is created once per composition and keeps
+  // the U235 to U238 atom ratio.
+  cyclus::Composition::Ptr uranium_comp = UraniumCache::UraniumComp(
+      mat->comp());
+  EXPECT_EQ(uranium_comp, UraniumCache::UraniumComp(mat->comp()));
+  EXPECT_EQ(2, uranium_comp->atom().size());
+  EXPECT_NEAR(mq.atom_frac(922350000) / mq.atom_frac(nucs),
+              UraniumCache::Get(uranium_comp).u235_atom, 1e-12);
+  EXPECT_NEAR(0.02 / 0.67, UraniumCache::Get(uranium_comp).assay_mass, 1e-12);
+
+  UraniumCache::set_enabled(false);
+  EXPECT_NE(uranium_comp, UraniumCache::UraniumComp(mat->comp()));
+  EXPECT_NEAR(0.02 / 0.67, UraniumCache::Get(mat).assay_mass, 1e-12);
+  EXPECT_EQ(0, UraniumCache::size());
+  UraniumCache::set_enabled(true);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, EnrichmentMemo) {
+  using cyclus::toolkit::Assays;
+
+  double feeds[] = {0.00711, 0.03, 0.2};
+  double products[] = {0.035, 0.2, 0.93};
+  for (double feed : feeds) {
+    for (double product : products) {
+      if (product <= feed) {
+        continue;
+      }
+      Assays assays(feed, product, tails_assay);
+      for (double qty : {0.5, 1., 1234.}) {
+        double swu = cyclus::toolkit::SwuRequired(qty, assays);
+        double feed_qty = cyclus::toolkit::FeedQty(qty, assays);
+        EXPECT_NEAR(swu, EnrichmentMemo::SwuRequired(qty, assays),
+                    1e-9 * swu);
+        EXPECT_NEAR(feed_qty, EnrichmentMemo::FeedQty(qty, assays),
+                    1e-9 * feed_qty);
+      }
+    }
+  }
+
+  // Triples differing by rounding errors share one entry.
+  EnrichmentMemo::ResetCounters();
+  EnrichmentMemo::Get(Assays(0.00711, 0.045, tails_assay));
+  EnrichmentMemo::Get(Assays(0.00711 * (1 + 1e-15), 0.045, tails_assay));
+  EnrichmentMemo::Get(Assays(0.00711, 0.045, tails_assay));
+  EXPECT_EQ(2, EnrichmentMemo::hits());
+  EXPECT_EQ(1, EnrichmentMemo::misses());
+  EnrichmentMemo::Get(Assays(0.00711, 0.046, tails_assay));
+  EXPECT_EQ(2, EnrichmentMemo::hits());
+
+  // Batch-computed entries are served as hits and match the toolkit.
+  std::vector<double> batch = {0.051, 0.052, 0.053, 0.054, 0.055};
+  EnrichmentMemo::Warm(0.00711, tails_assay, batch);
+  EnrichmentMemo::ResetCounters();
+  for (double product : batch) {
+    Assays assays(0.00711, product, tails_assay);
+    double swu = cyclus::toolkit::SwuRequired(1., assays);
+    EXPECT_NEAR(swu, EnrichmentMemo::SwuRequired(1., assays), 1e-12 * swu);
+  }
+  EXPECT_EQ(batch.size(), EnrichmentMemo::hits());
+  EXPECT_EQ(0, EnrichmentMemo::misses());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, EnrichmentMemoWarmsUsedFeeds) {
+  // The factors are only computed in advance for the feeds that the
+  // planning considers. The preferred LEU feed suffices, hence the factors
+  // of the natural uranium feed are not computed.
+  using cyclus::Material;
+  using cyclus::toolkit::Assays;
+
+  cyclus::CompMap cm;
+  cm[922350000] = 45.67;
+  cm[922380000] = 54.33;
+  cyclus::compmath::Normalize(&cm);
+  Material::Ptr product = Material::CreateUntracked(
+      1, cyclus::Composition::CreateFromMass(cm));
+  DoAddFeedMat(Material::CreateUntracked(inv_size, test::NaturalU()),
+               feed_commods[0]);
+  DoAddFeedMat(Material::CreateUntracked(inv_size, test::LowEnrichedU()),
+               feed_commods[1]);
+  DoEnrichGroup(std::vector<Material::Ptr>(2, product),
+                std::vector<double>(2, 1.));
+  EXPECT_NEAR(inv_size, DoFeedQty(0), 1e-8);
+
+  double product_assay = UraniumCache::AssayMass(product);
+  EnrichmentMemo::ResetCounters();
+  EnrichmentMemo::Get(Assays(0.03, product_assay, tails_assay));
+  EXPECT_EQ(1, EnrichmentMemo::hits());
+  EnrichmentMemo::Get(Assays(0.00711, product_assay, tails_assay));
+  EXPECT_EQ(1, EnrichmentMemo::misses());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, Converters) {
+  typedef cyclus::Converter<cyclus::Material>::Ptr ConverterPtr;
+
+  ConverterPtr swu = SwuConverter::Get(0.0072, tails_assay);
+  ConverterPtr feed = FeedConverter::Get(0.0072, tails_assay);
+  EXPECT_EQ(swu, SwuConverter::Get(0.0072, tails_assay));
+  EXPECT_EQ(feed, FeedConverter::Get(0.0072, tails_assay));
+  EXPECT_NE(swu, SwuConverter::Get(0.03, tails_assay));
+  EXPECT_TRUE(*swu == *swu);
+
+  // Separately created converters are equal by value and comparing different
+  // converter types does not dereference a failed cast.
+  SwuConverter swu_copy(0.0072, tails_assay);
+  EXPECT_TRUE(*swu == swu_copy);
+  EXPECT_FALSE(*SwuConverter::Get(0.03, tails_assay) == swu_copy);
+  EXPECT_FALSE(*swu == *feed);
+  EXPECT_FALSE(*feed == *swu);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, DISABLED_GetMatlBidsBenchmark) {
+  // Compare the cost of bidding on many requests with and without the
+  // `UraniumCache`. Run with `--gtest_also_run_disabled_tests`.
+  using cyclus::Material;
+  using Clock = std::chrono::steady_clock;
+
+  const int n_requests = 1000;
+  const int n_passes = 20;
+  cyclus::Composition::Ptr product_comps[] = {
+      test::LowEnrichedU(), test::HighlyEnrichedU(), test::WeapongradeU()};
+  cyclus::CommodMap<Material>::type out_requests;
+  for (int i = 0; i < n_requests; ++i) {
+    Material::Ptr product = Material::CreateUntracked(0.1,
+                                                      product_comps[i % 3]);
+    out_requests[product_commod].push_back(cyclus::Request<Material>::Create(
+        product, flex_enrich_facility, product_commod));
+  }
+  DoAddFeedMat(Material::CreateUntracked(inv_size, test::NaturalU()),
+               feed_commods[0]);
+
+  double ms[2];
+  for (int enabled = 0; enabled < 2; ++enabled) {
+    UraniumCache::set_enabled(enabled);
+    Clock::time_point start = Clock::now();
+    for (int pass = 0; pass < n_passes; ++pass) {
+      flex_enrich_facility->GetMatlBids(out_requests);
+    }
+    ms[enabled] = std::chrono::duration<double, std::milli>(
+        Clock::now() - start).count() / n_passes;
+  }
+
+  std::cout << "[ BENCH    ] GetMatlBids with " << n_requests
+            << " requests\n"
+            << "[ BENCH    ] without UraniumCache: " << ms[0] << " ms/pass\n"
+            << "[ BENCH    ] with UraniumCache:    " << ms[1] << " ms/pass"
+            << std::endl;
+  EXPECT_LT(ms[1], ms[0]);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, AdjustMatlPrefs) {
+  // Bids are ranked by the U235 content of their offers, bids without U235
+  // are ignored. The ranks are the positions in the sorted bids, hence they
+  // start after the ignored ones.
+  using cyclus::Bid;
+  using cyclus::Material;
+
+  cyclus::CompMap cm;
+  cm[922380000] = 1.;
+  cyclus::Composition::Ptr no_u235 = cyclus::Composition::CreateFromMass(cm);
+  cyclus::Composition::Ptr comps[] = {test::WeapongradeU(), no_u235,
+                                      test::NaturalU(), test::LowEnrichedU()};
+  int expected[] = {4, -1, 2, 3};
+
+  cyclus::Request<Material>* req = cyclus::Request<Material>::Create(
+      Material::CreateUntracked(1, test::NaturalU()), flex_enrich_facility,
+      feed_commods[0]);
+  cyclus::PrefMap<Material>::type prefs;
+  std::vector<Bid<Material>*> bids;
+  for (cyclus::Composition::Ptr comp : comps) {
+    bids.push_back(Bid<Material>::Create(
+        req, Material::CreateUntracked(1, comp), flex_enrich_facility));
+    prefs[req][bids.back()] = 1;
+  }
+
+  DoSetOrderPrefs(true);
+  flex_enrich_facility->AdjustMatlPrefs(prefs);
+  for (int i = 0; i < bids.size(); ++i) {
+    EXPECT_EQ(expected[i], prefs[req][bids[i]]);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, DISABLED_AdjustMatlPrefsBenchmark) {
+  // Rank 500 bids per request. Run with `--gtest_also_run_disabled_tests`.
+  using cyclus::Bid;
+  using cyclus::Material;
+  using Clock = std::chrono::steady_clock;
+
+  const int n_requests = 10;
+  const int n_bids = 500;
+  const int n_passes = 20;
+  cyclus::PrefMap<Material>::type prefs;
+  for (int i = 0; i < n_requests; ++i) {
+    cyclus::Request<Material>* req = cyclus::Request<Material>::Create(
+        Material::CreateUntracked(1, test::NaturalU()), flex_enrich_facility,
+        feed_commods[0]);
+    for (int j = 0; j < n_bids; ++j) {
+      cyclus::CompMap cm;
+      cm[922350000] = 0.1 + j % 97;
+      cm[922380000] = 100.;
+      Material::Ptr offer = Material::CreateUntracked(
+          1, cyclus::Composition::CreateFromMass(cm));
+      prefs[req][Bid<Material>::Create(req, offer, flex_enrich_facility)] = 1;
+    }
+  }
+
+  DoSetOrderPrefs(true);
+  Clock::time_point start = Clock::now();
+  for (int pass = 0; pass < n_passes; ++pass) {
+    flex_enrich_facility->AdjustMatlPrefs(prefs);
+  }
+  double ms = std::chrono::duration<double, std::milli>(
+      Clock::now() - start).count() / n_passes;
+
+  std::cout << "[ BENCH    ] AdjustMatlPrefs with " << n_requests
+            << " requests and " << n_bids << " bids each: " << ms
+            << " ms/pass" << std::endl;
+  for (auto& req_prefs : prefs) {
+    std::set<double> ranks;
+    for (auto& bid_pref : req_prefs.second) {
+      ranks.insert(bid_pref.second);
+    }
+    EXPECT_EQ(n_bids, ranks.size());
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, CompactTails) {
+  using cyclus::Material;
+
+  cyclus::toolkit::ResBuf<Material>& tails_inv = DoTailsInv();
+  for (int i = 0; i < 100; ++i) {
+    tails_inv.Push(Material::CreateUntracked(0.5, test::DepletedU()));
+  }
+  tails_inv.Push(Material::CreateUntracked(2., test::NaturalU()));
+  ASSERT_NO_THROW(DoCompactTails());
+  EXPECT_EQ(2, tails_inv.count());
+  EXPECT_DOUBLE_EQ(52., tails_inv.quantity());
+
+  // Compacting again does not change anything.
+  DoCompactTails();
+  EXPECT_EQ(2, tails_inv.count());
+  cyclus::toolkit::MatVec materials = tails_inv.PopN(2);
+  EXPECT_DOUBLE_EQ(50., materials[0]->quantity());
+  EXPECT_NEAR(0.003, UraniumCache::AssayMass(materials[0]), 1e-12);
+  EXPECT_DOUBLE_EQ(2., materials[1]->quantity());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, DISABLED_TailsBidsBenchmark) {
+  // Bid on many tails requests with a fragmented tails inventory and compare
+  // against the cost of popping and pushing the inventory once per request,
+  // as done previously. Run with `--gtest_also_run_disabled_tests`.
+  using cyclus::Material;
+  using Clock = std::chrono::steady_clock;
+
+  const int n_requests = 100;
+  const int n_materials = 10000;
+  const int n_passes = 5;
+  cyclus::CommodMap<Material>::type out_requests;
+  for (int i = 0; i < n_requests; ++i) {
+    Material::Ptr tails = Material::CreateUntracked(1, test::DepletedU());
+    out_requests[tails_commod].push_back(cyclus::Request<Material>::Create(
+        tails, flex_enrich_facility, tails_commod));
+  }
+  cyclus::toolkit::ResBuf<Material>& tails_inv = DoTailsInv();
+  for (int i = 0; i < n_materials; ++i) {
+    tails_inv.Push(Material::CreateUntracked(0.1, test::DepletedU()));
+  }
+
+  Clock::time_point start = Clock::now();
+  std::set<cyclus::BidPortfolio<Material>::Ptr> ports;
+  for (int pass = 0; pass < n_passes; ++pass) {
+    ports = flex_enrich_facility->GetMatlBids(out_requests);
+  }
+  double ms_bids = std::chrono::duration<double, std::milli>(
+      Clock::now() - start).count() / n_passes;
+
+  start = Clock::now();
+  for (int pass = 0; pass < n_passes; ++pass) {
+    for (int i = 0; i < n_requests; ++i) {
+      tails_inv.Push(tails_inv.PopN(tails_inv.count()));
+    }
+  }
+  double ms_churn = std::chrono::duration<double, std::milli>(
+      Clock::now() - start).count() / n_passes;
+
+  ASSERT_EQ(1, ports.size());
+  EXPECT_EQ(n_requests * n_materials, (*ports.begin())->bids().size());
+  EXPECT_EQ(n_materials, tails_inv.count());
+  std::cout << "[ BENCH    ] GetMatlBids with " << n_requests
+            << " tails requests and " << n_materials << " tails materials: "
+            << ms_bids << " ms/pass\n"
+            << "[ BENCH    ] avoided PopN/Push per request:  " << ms_churn
+            << " ms/pass" << std::endl;
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST_F(FlexibleEnrichmentTest, GetMatlBids) {
   // Test the bidding. At first no bids are expected because there are
@@ -265,6 +745,60 @@ TEST_F(FlexibleEnrichmentTest, GetMatlBids) {
   EXPECT_EQ(2, bids.size());
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, GetMatlTrades) {
+  // Trade the bids on two requests of the same product. Their offers share
+  // one composition, hence they are enriched as one group, which must yield
+  // the same products and SWU as two separate enrichments.
+  using cyclus::Bid;
+  using cyclus::Material;
+  using cyclus::Request;
+  using cyclus::Trade;
+
+  DoAddFeedMat(Material::CreateUntracked(inv_size, test::NaturalU()),
+               feed_commods[0]);
+
+  std::vector<Request<Material>*> requests;
+  cyclus::CommodMap<Material>::type out_requests;
+  for (double qty : {1., 2.}) {
+    Material::Ptr mat = Material::CreateUntracked(qty, test::HighlyEnrichedU());
+    requests.push_back(Request<Material>::Create(mat, flex_enrich_facility,
+                                                 product_commod));
+    out_requests[product_commod].push_back(requests.back());
+  }
+  std::set<cyclus::BidPortfolio<Material>::Ptr> ports =
+      flex_enrich_facility->GetMatlBids(out_requests);
+  ASSERT_EQ(1, ports.size());
+
+  std::vector<Trade<Material> > trades;
+  for (Request<Material>* req : requests) {
+    for (Bid<Material>* bid : (*ports.begin())->bids()) {
+      if (bid->request() == req) {
+        trades.push_back(Trade<Material>(req, bid, req->target()->quantity()));
+      }
+    }
+  }
+  ASSERT_EQ(2, trades.size());
+  EXPECT_EQ(trades[0].bid->offer()->comp()->id(),
+            trades[1].bid->offer()->comp()->id());
+
+  std::vector<std::pair<Trade<Material>, Material::Ptr> > responses;
+  flex_enrich_facility->GetMatlTrades(trades, responses);
+  ASSERT_EQ(2, responses.size());
+
+  double feed_assay = DoFeedAssay(0);
+  double expected_swu = 0;
+  for (int i = 0; i < responses.size(); ++i) {
+    Material::Ptr response = responses[i].second;
+    double product_assay = UraniumCache::AssayMass(trades[i].bid->offer());
+    EXPECT_NEAR(trades[i].amt, response->quantity(), 1e-9);
+    EXPECT_NEAR(product_assay, UraniumCache::AssayMass(response), 1e-12);
+    cyclus::toolkit::Assays assays(feed_assay, product_assay, tails_assay);
+    expected_swu += cyclus::toolkit::SwuRequired(trades[i].amt, assays);
+  }
+  EXPECT_NEAR(expected_swu, DoIntraTimestepSWU(), 1e-9 * expected_swu);
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST_F(FlexibleEnrichmentTest, DISABLED_BidPrefs) {
   // Test disabled, see https://git.rwth-aachen.de/nvd/fuel-cycle/flexicamore/-/issues/4
@@ -504,6 +1038,46 @@ TEST_F(FlexibleEnrichmentTest, RequestSim) {
   EXPECT_NEAR(m->quantity(), inv_size, 1e-10);
 }
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleEnrichmentTest, RecordGranularity) {
+  // Two sinks receive product in the same timestep. Per trade, two rows are
+  // recorded, per timestep one row with the summed feed and SWU.
+  std::vector<std::string> granularities = {"trade", "timestep"};
+  std::vector<cyclus::QueryResult> results;
+  for (std::string granularity : granularities) {
+    std::string config =
+      "   <feed_commods><val>"+feed_commods[0]+"</val></feed_commods> "
+      "   <product_commod>"+product_commod+"</product_commod> "
+      "   <tails_commod>depleted_U</tails_commod> "
+      "   <tails_assay>0.003</tails_assay> "
+      "   <max_feed_inventory>"+std::to_string(inv_size)+"</max_feed_inventory> "
+      "   <order_prefs>0</order_prefs>"
+      "   <record_granularity>"+granularity+"</record_granularity>"
+      "   <swu_capacity_times><val>0</val></swu_capacity_times> "
+      "   <swu_capacity_vals><val>10000</val></swu_capacity_vals> ";
+    int simdur = 2;
+    cyclus::MockSim sim(cyclus::AgentSpec(":flexicamore:FlexibleEnrichment"),
+                        config, simdur);
+    sim.AddRecipe(nu_recipe, test::NaturalU());
+    sim.AddRecipe(leu_recipe, test::LowEnrichedU());
+    sim.AddSource(feed_commods[0]).recipe(nu_recipe).Finalize();
+    sim.AddSink(product_commod).recipe(leu_recipe).capacity(1).Finalize();
+    sim.AddSink(product_commod).recipe(leu_recipe).capacity(2).Finalize();
+    sim.Run();
+    results.push_back(sim.db().Query("FlexibleEnrichments", NULL));
+  }
+  ASSERT_EQ(2, results[0].rows.size());
+  ASSERT_EQ(1, results[1].rows.size());
+  double feed_qty = results[0].GetVal<double>("feed_qty", 0)
+                    + results[0].GetVal<double>("feed_qty", 1);
+  double swu = results[0].GetVal<double>("SWU", 0)
+               + results[0].GetVal<double>("SWU", 1);
+  EXPECT_NEAR(feed_qty, results[1].GetVal<double>("feed_qty", 0), 1e-8);
+  EXPECT_NEAR(swu, results[1].GetVal<double>("SWU", 0), 1e-8);
+  EXPECT_EQ(results[0].GetVal<int>("Time", 0),
+            results[1].GetVal<int>("Time", 0));
+}
+
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 TEST_F(FlexibleEnrichmentTest, TailsTrade) {
   std::string config =
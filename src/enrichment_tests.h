@@ -53,12 +53,33 @@ class FlexibleEnrichmentTest : public ::testing::Test {
   inline void DoAddFeedMat(cyclus::Material::Ptr mat, std::string commodity) {
     flex_enrich_facility->AddFeedMat_(mat, commodity);
   }
-  inline void DoEnrich(cyclus::Material::Ptr mat, double qty) {
-    flex_enrich_facility->Enrich_(mat, qty);
+  inline cyclus::Material::Ptr DoEnrich(cyclus::Material::Ptr mat,
+                                        double qty) {
+    return flex_enrich_facility->Enrich_(mat, qty);
+  }
+  inline std::vector<cyclus::Material::Ptr> DoEnrichGroup(
+      const std::vector<cyclus::Material::Ptr>& mats,
+      const std::vector<double>& qtys) {
+    return flex_enrich_facility->EnrichGroup_(mats, qtys);
+  }
+  inline cyclus::toolkit::ResBuf<cyclus::Material>& DoTailsInv() {
+    return flex_enrich_facility->tails_inv;
+  }
+  inline void DoSetOrderPrefs(bool order) {
+    flex_enrich_facility->order_prefs = order;
+  }
+  inline void DoSetBlendFeeds(bool blend) {
+    flex_enrich_facility->blend_feeds = blend;
+  }
+  inline void DoCompactTails() {
+    flex_enrich_facility->CompactTails_();
   }
   inline double DoFeedQty(int idx) {
     return flex_enrich_facility->feed_inv[idx].quantity();
   }
+  inline double DoFeedAssay(int idx) {
+    return flex_enrich_facility->FeedAssay_(idx);
+  }
   inline std::vector<int> DoFeedIdxByPref() {
     return flex_enrich_facility->feed_idx_by_pref;
   }
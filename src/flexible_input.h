@@ -1,34 +1,604 @@
 #ifndef FLEXICAMORE_SRC_FLEXIBLE_INPUT_H_
 #define FLEXICAMORE_SRC_FLEXIBLE_INPUT_H_
 
+#include <algorithm>  // std::upper_bound
+#include <cmath>  // std::lround
+#include <cstddef>  // std::size_t
+#include <cstdint>  // std::uint64_t
+#include <limits>  // std::numeric_limits
+#include <memory>  // std::shared_ptr
+#include <sstream>
+#include <string>
+#include <type_traits>  // std::is_arithmetic, std::is_integral
+#include <utility>  // std::move
 #include <vector>
 
 #include "agent.h"
+#include "context.h"
+#include "error.h"
+
+#include "schedule_expression.h"
+#include "schedule_file.h"
+#include "schedule_store.h"
 
 namespace flexicamore {
 
+// Convert the interpolation name used in input files ('step' or 'linear').
+inline Interpolation ParseInterpolation(const std::string& name) {
+  if (name == "step") {
+    return Interpolation::kStep;
+  } else if (name == "linear") {
+    return Interpolation::kLinear;
+  }
+  std::stringstream ss;
+  ss << "Unknown FlexibleInput interpolation '" << name << "', expected "
+     << "'step' or 'linear'.\n";
+  throw cyclus::ValueError(ss.str());
+}
+
+// `FlexibleInput` is header-only such that it can be used with any value type
+// and such that the per-timestep lookup can be inlined into the calling
+// `Tick` functions. Explicit instantiations for commonly used types are
+// compiled into the library in `flexible_input.cc`.
+//
+// The schedule itself is immutable and shared via the `ScheduleStore` between
+// all `FlexibleInput` variables with identical content, only the position in
+// the schedule is kept per variable.
 template <typename T>
 class FlexibleInput {
  public:
   FlexibleInput();
+  // One value per timestep. Runs of equal values are collapsed into their
+  // change points at construction, such that memory and lookups scale with
+  // the number of changes instead of the simulation duration.
   FlexibleInput(cyclus::Agent* parent, std::vector<T> value);
+  // With linear interpolation, only the knots of a piecewise-linear
+  // schedule (e.g., the start and end of a ramp) need to be given. The last
+  // value is kept after the last knot. Linear interpolation requires an
+  // arithmetic value type, integral values are rounded.
   FlexibleInput(cyclus::Agent* parent, std::vector<T> value,
-                std::vector<int> time);
+                std::vector<int> time,
+                Interpolation interpolation = Interpolation::kStep);
+
+  // Read the schedule from a file instead of the input file, see
+  // `schedule_file.h` for the supported formats. CSV files (`*.csv`) are
+  // parsed, all other files are memory-mapped and must contain the raw
+  // values of all timesteps. `interpolation` only applies to CSV files with
+  // change times.
+  static FlexibleInput<T> FromFile(
+      cyclus::Agent* parent, const std::string& path,
+      Interpolation interpolation = Interpolation::kStep);
+
+  // Compute the value from a formula of the relative time `t` instead of
+  // storing a schedule, see `ScheduleExpression` for the syntax. The
+  // expression is compiled once and evaluated at most once per timestep.
+  // Integral values are rounded. Random functions in the expression use the
+  // stream derived from `seed`, the ensemble `member` and the id of `parent`.
+  static FlexibleInput<T> FromExpression(cyclus::Agent* parent,
+                                         const std::string& expression,
+                                         std::uint64_t seed = 0,
+                                         std::uint64_t member = 0);
+
+  friend class FlexibleInputTest;
+  template <typename U> friend class ScheduleRegistry;
+
+  // Return the value at the current time of `parent` (measured relative to
+  // its entry into the simulation). Consecutive or unchanged timesteps are
+  // served in O(1), any other time (skipped timesteps, restarts, going back
+  // in time) in O(log n) with n being the number of change points.
+  // Schedules consisting of a single value are detected at construction and
+  // reduce to returning that value.
+  inline T UpdateValue(cyclus::Agent* parent) {
+    if (constant_) {
+      return constant_value_;
+    }
+    return UpdateSchedule_(parent);
+  }
+
+  // True if the value never changes over the lifetime of the parent.
+  inline bool constant() const { return constant_; }
 
-  T UpdateValue(cyclus::Agent* parent);
+  // Position in the schedule, i.e., the index of the change point used last.
+  // Agents store it as state variable such that restarted simulations
+  // continue from there instead of searching the schedule again.
+  inline std::size_t cursor() const { return time_idx_; }
+  // Restore the position, invalid positions (e.g., after the schedule in the
+  // input file has been shortened) are ignored. As `UpdateValue` checks the
+  // position, any valid one yields correct values.
+  void set_cursor(std::size_t idx);
+
+  // Return the value at relative time `t` without moving the cursor, i.e.,
+  // schedules may be queried in any order. Runs in O(log n).
+  T ValueAt(int t) const;
+
+  // Minimum, maximum and sum of the values at the relative timesteps
+  // `t, ..., t + k`, e.g., to size orders to the capacity of the upcoming
+  // timesteps. Like `ValueAt`, they neither move the cursor nor allocate
+  // memory. Stored schedules are answered in O(log n) from tables built once
+  // per schedule, memory-mapped and expression schedules are evaluated at
+  // each timestep of the window. Only available for numerical values. With
+  // linear interpolation, the sum uses the unrounded values.
+  T WindowMin(int t, int k) const;
+  T WindowMax(int t, int k) const;
+  double WindowSum(int t, int k) const;
 
  private:
+  void CheckInterpolation_(cyclus::Agent* parent,
+                           Interpolation interpolation);
+  void CheckSize_(cyclus::Agent* parent, std::size_t size);
   void CheckInput_(cyclus::Agent* parent, const std::vector<T>& value);
   void CheckInput_(cyclus::Agent* parent, const std::vector<T>& value,
                    const std::vector<int>& time);
 
-  std::vector<T> value_;
-  std::vector<int> time_;
-  // The time iterator points to the time corresponding to the value
-  // currently used.
-  std::vector<int>::iterator time_it_;
+  // Index of the change point that is valid at relative time `t >= 0`.
+  std::size_t Index_(int t) const;
+  // Value at relative time `t` which lies in the segment starting at change
+  // point `idx`.
+  T Interpolate_(std::size_t idx, int t) const;
+  // Value of `expression_` at relative time `t`.
+  T Evaluate_(int t) const;
+  void CheckWindow_(int t, int k) const;
+  // Minimum (`max == false`) or maximum of the values over a window.
+  T WindowExtremum_(int t, int k, bool max) const;
+  // Minimum or maximum of the change point values `lo, ..., hi`.
+  T RangeExtremum_(std::size_t lo, std::size_t hi, bool max) const;
+  // Sum of the values at the relative timesteps `0, ..., t - 1`.
+  double Cumulative_(int t) const;
+  T UpdateSchedule_(cyclus::Agent* parent);
+  T UpdateValue_(int t);
+
+  bool constant_;
+  T constant_value_;
+  typename ScheduleStore<T>::Ptr schedule_;
+  // Index into the schedule's time and value vectors of the value currently
+  // used.
+  std::size_t time_idx_;
+  // Only set for memory-mapped schedules, `schedule_` is unused then.
+  typename MappedSeries<T>::Ptr series_;
+  // Only set for expression schedules, `schedule_` is unused then.
+  std::shared_ptr<const ScheduleExpression> expression_;
+  std::uint64_t expression_stream_;
+  // Time and result of the last evaluation of `expression_`.
+  int expression_time_;
+  T expression_value_;
 };
 
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+FlexibleInput<T>::FlexibleInput()
+    : constant_(false), constant_value_(), time_idx_(0),
+      expression_stream_(0), expression_time_(-1), expression_value_() {;}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+FlexibleInput<T>::FlexibleInput(cyclus::Agent* parent,
+                                std::vector<T> value)
+    : constant_(false), constant_value_(), time_idx_(0),
+      expression_stream_(0), expression_time_(-1), expression_value_() {
+  CheckInput_(parent, value);
+  std::vector<int> time;
+  CompressRuns(&value, &time);
+  constant_ = value.size() == 1;
+  if (constant_) {
+    constant_value_ = value.front();
+  }
+  schedule_ = ScheduleStore<T>::Intern(std::move(value), std::move(time));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+FlexibleInput<T>::FlexibleInput(cyclus::Agent* parent,
+                                std::vector<T> value,
+                                std::vector<int> time,
+                                Interpolation interpolation)
+    : constant_(value.size() == 1), constant_value_(), time_idx_(0),
+      expression_stream_(0), expression_time_(-1), expression_value_() {
+  CheckInput_(parent, value, time);
+  CheckInterpolation_(parent, interpolation);
+  if (constant_) {
+    constant_value_ = value.front();
+  }
+  schedule_ = ScheduleStore<T>::Intern(std::move(value), std::move(time),
+                                       interpolation);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+FlexibleInput<T> FlexibleInput<T>::FromFile(cyclus::Agent* parent,
+                                            const std::string& path,
+                                            Interpolation interpolation) {
+  FlexibleInput<T> f;
+  if (IsCsvScheduleFile(path)) {
+    std::size_t n_timesteps;
+    f.schedule_ = ReadCsvSchedule<T>(path, interpolation, &n_timesteps);
+    f.CheckSize_(parent, n_timesteps);
+    f.CheckInput_(parent, f.schedule_->value, f.schedule_->time);
+    f.CheckInterpolation_(parent, f.schedule_->interpolation);
+    f.constant_ = f.schedule_->value.size() == 1;
+    f.constant_value_ = f.schedule_->value.front();
+  } else if constexpr (std::is_arithmetic<T>::value) {
+    f.series_ = MappedSeries<T>::Open(path);
+    f.CheckSize_(parent, f.series_->size());
+    f.constant_ = f.series_->size() == 1;
+    f.constant_value_ = (*f.series_)[0];
+  } else {
+    std::stringstream ss;
+    ss << "While initialising agent '" << parent->prototype()
+       << "' of spec '" << parent->spec() << "' at time '"
+       << parent->context()->time() << "' a problem appeared:\n"
+       << "binary schedule files are only available for numerical values, "
+       << "use a CSV file instead of '" << path << "'.\n";
+
+    throw cyclus::ValueError(ss.str());
+  }
+  return f;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+FlexibleInput<T> FlexibleInput<T>::FromExpression(
+    cyclus::Agent* parent, const std::string& expression, std::uint64_t seed,
+    std::uint64_t member) {
+  if constexpr (!std::is_arithmetic<T>::value) {
+    std::stringstream ss;
+    ss << "While initialising agent '" << parent->prototype()
+       << "' of spec '" << parent->spec() << "' at time '"
+       << parent->context()->time() << "' a problem appeared:\n"
+       << "expression schedules are only available for numerical values.\n";
+
+    throw cyclus::ValueError(ss.str());
+  }
+
+  FlexibleInput<T> f;
+  f.expression_.reset(new ScheduleExpression(expression));
+  f.expression_stream_ = ScheduleExpression::Stream(seed, member,
+                                                      parent->id());
+  f.expression_time_ = 0;
+  f.expression_value_ = f.Evaluate_(0);
+  if (f.expression_->constant()) {
+    f.constant_ = true;
+    f.constant_value_ = f.expression_value_;
+  }
+  return f;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+T FlexibleInput<T>::UpdateSchedule_(cyclus::Agent* parent) {
+  // Get current time with t = 0 being the entrance of parent in the
+  // simulation.
+  int t = parent->context()->time() - parent->enter_time();
+
+  if (t < 0) {
+    std::stringstream ss;
+    ss << "Agent '" << parent->prototype()
+       << "' of spec '" << parent->spec()
+       << "' with enter_time '" << parent->enter_time()
+       << "' has passed the invalid timestamp '" << t << "' at time '"
+       << parent->context()->time() << "' to a FlexibleInput variable.\n";
+
+    throw cyclus::ValueError(ss.str());
+  }
+  return UpdateValue_(t);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void FlexibleInput<T>::set_cursor(std::size_t idx) {
+  if (schedule_ && idx < schedule_->time.size()) {
+    time_idx_ = idx;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+T FlexibleInput<T>::ValueAt(int t) const {
+  if (t < 0) {
+    std::stringstream ss;
+    ss << "FlexibleInput variable queried at the invalid relative timestamp '"
+       << t << "'.\n";
+
+    throw cyclus::ValueError(ss.str());
+  }
+  if (series_) {
+    return (*series_)[std::min<std::size_t>(t, series_->size() - 1)];
+  } else if (expression_) {
+    return Evaluate_(t);
+  }
+  return Interpolate_(Index_(t), t);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+T FlexibleInput<T>::WindowMin(int t, int k) const {
+  return WindowExtremum_(t, k, false);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+T FlexibleInput<T>::WindowMax(int t, int k) const {
+  return WindowExtremum_(t, k, true);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+double FlexibleInput<T>::WindowSum(int t, int k) const {
+  CheckWindow_(t, k);
+  if constexpr (std::is_arithmetic<T>::value) {
+    if (constant_) {
+      return (k + 1.) * constant_value_;
+    } else if (series_ || expression_) {
+      // Memory-mapped schedules keep their last value after the end.
+      int end = t + k;
+      if (series_) {
+        end = std::max<int>(t, std::min<int>(end, series_->size() - 1));
+      }
+      double sum = 0;
+      for (int s = t; s <= end; ++s) {
+        sum += ValueAt(s);
+      }
+      return sum + static_cast<double>(t + k - end) * ValueAt(end);
+    }
+    return Cumulative_(t + k + 1) - Cumulative_(t);
+  } else {
+    // Not reachable, `CheckWindow_` rejects non-numerical types.
+    return 0;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+T FlexibleInput<T>::WindowExtremum_(int t, int k, bool max) const {
+  CheckWindow_(t, k);
+  if (constant_) {
+    return constant_value_;
+  }
+
+  T result = ValueAt(t);
+  if (series_ || expression_) {
+    int end = t + k;
+    if (series_) {
+      end = std::min<int>(end, series_->size() - 1);
+    }
+    for (int s = t + 1; s <= end; ++s) {
+      T value = ValueAt(s);
+      result = max ? std::max(result, value) : std::min(result, value);
+    }
+    return result;
+  }
+
+  // Within a segment, the values are constant or linear, hence the extrema
+  // lie at the ends of the window or at the change points within it.
+  std::size_t lo = Index_(t);
+  std::size_t hi = Index_(t + k);
+  if (lo < hi) {
+    T value = RangeExtremum_(lo + 1, hi, max);
+    result = max ? std::max(result, value) : std::min(result, value);
+  }
+  if (schedule_->interpolation == Interpolation::kLinear) {
+    T value = Interpolate_(hi, t + k);
+    result = max ? std::max(result, value) : std::min(result, value);
+  }
+  return result;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+T FlexibleInput<T>::RangeExtremum_(std::size_t lo, std::size_t hi,
+                                   bool max) const {
+  // Two (overlapping) ranges of length 2^j cover `lo, ..., hi`.
+  std::size_t j = 0;
+  while ((std::size_t(2) << j) <= hi - lo + 1) {
+    ++j;
+  }
+  std::size_t second = hi + 1 - (std::size_t(1) << j);
+  if (j == 0) {
+    const std::vector<T>& value = schedule_->value;
+    return max ? std::max(value[lo], value[second])
+               : std::min(value[lo], value[second]);
+  }
+  const WindowTables<T>& tables = GetWindowTables(*schedule_);
+  if (max) {
+    const std::vector<T>& table = tables.range_max[j-1];
+    return std::max(table[lo], table[second]);
+  }
+  const std::vector<T>& table = tables.range_min[j-1];
+  return std::min(table[lo], table[second]);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+double FlexibleInput<T>::Cumulative_(int t) const {
+  if constexpr (std::is_arithmetic<T>::value) {
+    std::size_t idx = Index_(t);
+    return GetWindowTables(*schedule_).prefix_sum[idx]
+           + SegmentSum(*schedule_, idx, t - schedule_->time[idx]);
+  } else {
+    return 0;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void FlexibleInput<T>::CheckWindow_(int t, int k) const {
+  if (!std::is_arithmetic<T>::value) {
+    throw cyclus::ValueError("FlexibleInput window queries are only "
+                             "available for numerical values.\n");
+  }
+  if (t < 0 || k < 0 || k > std::numeric_limits<int>::max() - 1 - t) {
+    std::stringstream ss;
+    ss << "FlexibleInput variable queried over the invalid window of "
+       << "relative timestamps '" << t << "' to '" << t << " + " << k
+       << "'.\n";
+
+    throw cyclus::ValueError(ss.str());
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+T FlexibleInput<T>::UpdateValue_(int t) {
+  if (series_) {
+    return (*series_)[std::min<std::size_t>(t, series_->size() - 1)];
+  } else if (expression_) {
+    if (t != expression_time_) {
+      expression_time_ = t;
+      expression_value_ = Evaluate_(t);
+    }
+    return expression_value_;
+  }
+  // Fast path for the usual case of one call per timestep: the value is
+  // either still valid or the next change point has been reached. The
+  // bounds checks take the ending of the time vector into account.
+  const std::vector<int>& time = schedule_->time;
+  std::size_t next = time_idx_ + 1;
+  if (t >= time[time_idx_]) {
+    if (next == time.size() || t < time[next]) {
+      return Interpolate_(time_idx_, t);
+    } else if (next + 1 == time.size() || t < time[next + 1]) {
+      time_idx_ = next;
+      return Interpolate_(time_idx_, t);
+    }
+  }
+  // Timesteps have been skipped or time went backwards, e.g., after a
+  // restart.
+  time_idx_ = Index_(t);
+  return Interpolate_(time_idx_, t);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+T FlexibleInput<T>::Interpolate_(std::size_t idx, int t) const {
+  const Schedule<T>& schedule = *schedule_;
+  if constexpr (std::is_arithmetic<T>::value) {
+    if (schedule.interpolation == Interpolation::kLinear
+        && idx + 1 < schedule.time.size()) {
+      double frac = static_cast<double>(t - schedule.time[idx])
+                    / (schedule.time[idx+1] - schedule.time[idx]);
+      double value = schedule.value[idx]
+                     + frac * (schedule.value[idx+1] - schedule.value[idx]);
+      if constexpr (std::is_integral<T>::value) {
+        return static_cast<T>(std::lround(value));
+      } else {
+        return static_cast<T>(value);
+      }
+    }
+  }
+  return schedule.value[idx];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+T FlexibleInput<T>::Evaluate_(int t) const {
+  if constexpr (std::is_integral<T>::value) {
+    return static_cast<T>(std::lround(
+        expression_->Evaluate(t, expression_stream_)));
+  } else if constexpr (std::is_arithmetic<T>::value) {
+    return static_cast<T>(expression_->Evaluate(t, expression_stream_));
+  } else {
+    // Not reachable, `FromExpression` rejects non-numerical types.
+    return T();
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+std::size_t FlexibleInput<T>::Index_(int t) const {
+  // `time[0] == 0 <= t` is guaranteed, hence the first element greater than
+  // `t` is never `time.begin()`.
+  const std::vector<int>& time = schedule_->time;
+  std::vector<int>::const_iterator it = std::upper_bound(time.begin(),
+                                                         time.end(), t);
+  return (it - time.begin()) - 1;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void FlexibleInput<T>::CheckInterpolation_(cyclus::Agent* parent,
+                                           Interpolation interpolation) {
+  if (!std::is_arithmetic<T>::value
+      && interpolation == Interpolation::kLinear) {
+    std::stringstream ss;
+    ss << "While initialising agent '" << parent->prototype()
+       << "' of spec '" << parent->spec() << "' at time '"
+       << parent->context()->time() << "' a problem appeared:\n"
+       << "linear interpolation is only available for numerical values.\n";
+
+    throw cyclus::ValueError(ss.str());
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void FlexibleInput<T>::CheckSize_(cyclus::Agent* parent, std::size_t size) {
+  int lifetime = parent->lifetime();
+  if (lifetime == -1) {
+    lifetime = parent->context()->sim_info().duration;
+  }
+
+  if (size > lifetime) {
+    std::stringstream ss;
+    ss << "While initialising agent '" << parent->prototype()
+       << "' of spec '" << parent->spec() << "' at time "
+       << parent->context()->time() << " a problem appeared:\n"
+       << "The value vector passed to FlexibleInput contains too many "
+       << "elements.\n";
+
+   throw cyclus::ValueError(ss.str());
+ }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void FlexibleInput<T>::CheckInput_(cyclus::Agent* parent,
+                                   const std::vector<T>& value) {
+  CheckSize_(parent, value.size());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void FlexibleInput<T>::CheckInput_(cyclus::Agent* parent,
+                                   const std::vector<T>& value,
+                                   const std::vector<int>& time_vec) {
+  CheckInput_(parent, value);
+  if (value.size() != time_vec.size()) {
+    std::stringstream ss;
+    ss << "While initialising agent '" << parent->prototype()
+       << "' of spec '" << parent->spec() << "' at time '"
+       << parent->context()->time() << "' a problem appeared:\n"
+       << "time and value vectors do not have the same size.\n"
+       << "size of time vector: " << time_vec.size()
+       << ", size of value vector: " << value.size() << "\n";
+
+    throw cyclus::ValueError(ss.str());
+  }
+
+  if (time_vec[0] != 0) {
+    std::stringstream ss;
+    ss << "While initialising agent '" << parent->prototype()
+       << "' of spec '" << parent->spec() << "' at time '"
+       << parent->context()->time() << "' a problem appeared:\n"
+       << "the first element of the time vector must be '0' (initial "
+       << "value).\n";
+
+    throw cyclus::ValueError(ss.str());
+  }
+
+  for (int i = 1; i < time_vec.size(); ++i) {
+    if (time_vec[i] <= time_vec[i-1]) {
+      std::stringstream ss;
+      ss << "While initialising agent '" << parent->prototype()
+         << "' of spec '" << parent->spec() << "' at time '"
+         << parent->context()->time() << "' a problem appeared:\n"
+         << "the time vector must be strictly increasing, but element "
+         << i << " ('" << time_vec[i] << "') does not exceed its "
+         << "predecessor ('" << time_vec[i-1] << "').\n";
+
+      throw cyclus::ValueError(ss.str());
+    }
+  }
+}
+
 }  // namespace flexicamore
 
 #endif  // FLEXICAMORE_SRC_FLEXIBLE_INPUT_H_
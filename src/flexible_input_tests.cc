@@ -1,7 +1,18 @@
 #include "flexible_input_tests.h"
 
+#include <algorithm>  // std::shuffle
 #include <array>
+#include <chrono>
+#include <cmath>  // std::pow
+#include <cstdio>  // std::remove
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <numeric>  // std::iota
+#include <random>
 #include <string>
+#include <utility>  // std::move
 #include <vector>
 
 #include "dynamic_module.h"  // for cyclus::AgentSpec
@@ -9,8 +20,91 @@
 #include "mock_sim.h"
 #include "pyhooks.h"
 
+#include "flexible_vector_input.h"
+#include "schedule_registry.h"
+
+#ifdef __linux__
+#include <sys/wait.h>  // waitpid
+#include <unistd.h>  // fork, pipe, sysconf
+#endif
+
 namespace flexicamore {
 
+namespace test {
+
+// Resident memory of the process in bytes, or -1 if not available.
+double ResidentMemory() {
+#ifdef __linux__
+  std::ifstream statm("/proc/self/statm");
+  double total_pages, resident_pages;
+  if (statm >> total_pages >> resident_pages) {
+    return resident_pages * sysconf(_SC_PAGESIZE);
+  }
+#endif
+  return -1;
+}
+
+// Run `measure` in a fresh child process and return its result, such that
+// memory measurements do not reuse memory freed by earlier ones. Returns -1
+// if not available.
+double MeasureInChild(const std::function<double()>& measure) {
+#ifdef __linux__
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return -1;
+  }
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    double result = measure();
+    ssize_t n_written = write(fds[1], &result, sizeof(result));
+    _exit(n_written == sizeof(result) ? 0 : 1);
+  }
+  close(fds[1]);
+  double result = -1;
+  if (pid < 0 || read(fds[0], &result, sizeof(result)) != sizeof(result)) {
+    result = -1;
+  }
+  close(fds[0]);
+  if (pid > 0) {
+    waitpid(pid, NULL, 0);
+  }
+  return result;
+#else
+  return -1;
+#endif
+}
+
+// Copy of the single-step cursor of `FlexibleInput` before random access
+// was added, for comparison in the lookup benchmark. It only advances by one
+// timestep at a time, hence out-of-order queries have to restart from the
+// beginning.
+template <typename T>
+class BaselineCursor {
+ public:
+  BaselineCursor(const std::vector<T>& value, const std::vector<int>& time)
+      : value_(value), time_(time), time_it_(time_.begin()) {}
+
+  void Restart() { time_it_ = time_.begin(); }
+
+  T UpdateValue(int t) {
+    if (t >= *time_it_ && (time_it_+1 == time_.end() || t < *(time_it_+1))) {
+      return value_[time_it_ - time_.begin()];
+    } else if (t == *(time_it_+1)) {
+      ++time_it_;
+      return value_[time_it_ - time_.begin()];
+    }
+    throw cyclus::ValueError("invalid timestamp");
+  }
+
+ private:
+  std::vector<T> value_;
+  std::vector<int> time_;
+  std::vector<int>::iterator time_it_;
+};
+
+}  // namespace test
+
 GTEST_ALLOW_UNINSTANTIATED_PARAMETERIZED_TEST(InstitutionTests);
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -25,12 +119,17 @@ FlexibleInputTest::~FlexibleInputTest() {
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 cyclus::MockSim FlexibleInputTest::SetUpMockSim() {
+  return SetUpMockSim(duration);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+cyclus::MockSim FlexibleInputTest::SetUpMockSim(int sim_duration) {
   std::string agent = ":agents:Source";
   std::string config = "<commod>test_commod</commod>"
                        "<recipe_name>test_recipe</recipe_name>"
                        "<capacity>1</capacity>";
 
-  return cyclus::MockSim(cyclus::AgentSpec(agent), config, duration);
+  return cyclus::MockSim(cyclus::AgentSpec(agent), config, sim_duration);
 }
 
 // - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
@@ -78,6 +177,650 @@ TEST_F(FlexibleInputTest, CheckDoubleInput) {
   // Not OK, time[0] is not 0
   EXPECT_THROW(FlexibleInput<int> fff(parent, vals, time);,
                cyclus::ValueError);
+
+  time = std::vector<int>({0, 5, 5});
+  // Not OK, time is not strictly increasing
+  EXPECT_THROW(FlexibleInput<int> ffff(parent, vals, time);,
+               cyclus::ValueError);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, RandomAccess) {
+  cyclus::MockSim sim = SetUpMockSim();
+  parent = sim.agent;
+
+  std::vector<int> time({0, 4, 5, 8});
+  std::vector<int> vals({10, 20, 30, 40});
+  std::vector<int> expected({10, 10, 10, 10, 20, 30, 30, 30, 40, 40});
+  FlexibleInput<int> f(parent, vals, time);
+
+  // Out-of-order queries do not depend on the cursor.
+  for (int t = duration - 1; t >= 0; --t) {
+    EXPECT_EQ(expected[t], f.ValueAt(t));
+  }
+  EXPECT_THROW(f.ValueAt(-1), cyclus::ValueError);
+
+  // Monotone updates, skipped timesteps and going back in time.
+  std::vector<int> query_times({0, 1, 4, 5, 9, 2, 8, 3, 6, 9});
+  for (int t : query_times) {
+    EXPECT_EQ(expected[t], DoUpdateValue(f, t));
+  }
+
+  // Method 2 is compressed into the same change points.
+  FlexibleInput<int> g(parent, expected);
+  EXPECT_EQ(time.size(), DoScheduleSize(g));
+  for (int t : query_times) {
+    EXPECT_EQ(expected[t], DoUpdateValue(g, t));
+    EXPECT_EQ(expected[t], g.ValueAt(t));
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, CompressedSchedule) {
+  const int long_duration = 20000;
+  cyclus::MockSim sim = SetUpMockSim(long_duration);
+  parent = sim.agent;
+
+  // Piecewise constant schedule with random change points, including runs of
+  // length one at the start and the end.
+  std::mt19937 gen(1);
+  std::uniform_int_distribution<int> run_length(1, 500);
+  std::vector<double> dense;
+  std::size_t n_changes = 0;
+  while (dense.size() < long_duration) {
+    int length = (n_changes == 0) ? 1 : run_length(gen);
+    dense.insert(dense.end(), length, 100. + n_changes);
+    ++n_changes;
+  }
+  dense.resize(long_duration - 1);
+  dense.push_back(-1.);
+  ++n_changes;
+
+  FlexibleInput<double> f(parent, dense);
+  EXPECT_FALSE(f.constant());
+  EXPECT_EQ(n_changes, DoScheduleSize(f));
+  for (int t = 0; t < long_duration; ++t) {
+    ASSERT_DOUBLE_EQ(dense[t], DoUpdateValue(f, t));
+  }
+  for (int t = long_duration - 1; t >= 0; t -= 7) {
+    ASSERT_DOUBLE_EQ(dense[t], f.ValueAt(t));
+    ASSERT_DOUBLE_EQ(dense[t], DoUpdateValue(f, t));
+  }
+  // The last value is kept after the end of the schedule.
+  EXPECT_DOUBLE_EQ(-1., f.ValueAt(2 * long_duration));
+
+  // A schedule without changes collapses into a constant.
+  FlexibleInput<int> g(parent, std::vector<int>(long_duration, 3));
+  EXPECT_TRUE(g.constant());
+  EXPECT_EQ(1, DoScheduleSize(g));
+  EXPECT_EQ(3, g.UpdateValue(parent));
+
+  // Alternating values cannot be compressed.
+  std::vector<int> alternating(long_duration);
+  for (int t = 0; t < long_duration; ++t) {
+    alternating[t] = t % 2;
+  }
+  FlexibleInput<int> h(parent, alternating);
+  EXPECT_EQ(long_duration, DoScheduleSize(h));
+  for (int t = 0; t < long_duration; t += 3) {
+    ASSERT_EQ(t % 2, DoUpdateValue(h, t));
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, Cursor) {
+  cyclus::MockSim sim = SetUpMockSim();
+  parent = sim.agent;
+
+  std::vector<int> time({0, 4, 5, 8});
+  std::vector<int> vals({10, 20, 30, 40});
+  FlexibleInput<int> f(parent, vals, time);
+  EXPECT_EQ(0, f.cursor());
+  DoUpdateValue(f, 6);
+  EXPECT_EQ(2, f.cursor());
+
+  // A restarted variable continues from the stored position.
+  FlexibleInput<int> g(parent, vals, time);
+  g.set_cursor(f.cursor());
+  EXPECT_EQ(2, g.cursor());
+  EXPECT_EQ(30, DoUpdateValue(g, 7));
+  EXPECT_EQ(40, DoUpdateValue(g, 8));
+  EXPECT_EQ(3, g.cursor());
+
+  // Invalid positions are ignored, wrong ones are corrected.
+  g.set_cursor(4);
+  EXPECT_EQ(3, g.cursor());
+  g.set_cursor(3);
+  EXPECT_EQ(10, DoUpdateValue(g, 1));
+  EXPECT_EQ(0, g.cursor());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, LinearInterpolation) {
+  cyclus::MockSim sim = SetUpMockSim();
+  parent = sim.agent;
+
+  // Ramp from 0 to 100 between t = 2 and t = 6, then constant.
+  std::vector<int> time({0, 2, 6});
+  std::vector<double> vals({0., 0., 100.});
+  std::vector<double> expected(
+      {0., 0., 0., 25., 50., 75., 100., 100., 100., 100.});
+  FlexibleInput<double> f(parent, vals, time, Interpolation::kLinear);
+  for (int t = 0; t < duration; ++t) {
+    EXPECT_DOUBLE_EQ(expected[t], DoUpdateValue(f, t));
+    EXPECT_DOUBLE_EQ(expected[t], f.ValueAt(t));
+  }
+  // Random access into the middle of a segment.
+  EXPECT_DOUBLE_EQ(75., DoUpdateValue(f, 5));
+  EXPECT_DOUBLE_EQ(25., DoUpdateValue(f, 3));
+
+  // Same knots with step interpolation yield a different schedule.
+  FlexibleInput<double> g(parent, vals, time);
+  EXPECT_DOUBLE_EQ(0., g.ValueAt(5));
+
+  // Integral values are rounded.
+  FlexibleInput<int> h(parent, std::vector<int>({0, 1}),
+                       std::vector<int>({0, 4}), Interpolation::kLinear);
+  std::vector<int> expected_int({0, 0, 1, 1, 1});
+  for (int t = 0; t < expected_int.size(); ++t) {
+    EXPECT_EQ(expected_int[t], h.ValueAt(t));
+  }
+
+  // Not OK, strings cannot be interpolated.
+  EXPECT_THROW(FlexibleInput<std::string> s(
+                   parent, std::vector<std::string>({"a", "b"}),
+                   std::vector<int>({0, 5}), Interpolation::kLinear);,
+               cyclus::ValueError);
+
+  EXPECT_EQ(Interpolation::kLinear, ParseInterpolation("linear"));
+  EXPECT_EQ(Interpolation::kStep, ParseInterpolation("step"));
+  EXPECT_THROW(ParseInterpolation("cubic"), cyclus::ValueError);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, WindowQueries) {
+  cyclus::MockSim sim = SetUpMockSim();
+  parent = sim.agent;
+
+  std::vector<int> time({0, 2, 3, 7, 12});
+  std::vector<double> vals({5., -1., 8., 2., 4.});
+  FlexibleInput<double> step(parent, vals, time);
+  FlexibleInput<double> linear(parent, vals, time, Interpolation::kLinear);
+  FlexibleInput<int> rounded(parent, std::vector<int>({0, 7, 2}),
+                             std::vector<int>({0, 3, 9}),
+                             Interpolation::kLinear);
+  FlexibleInput<double> expr = FlexibleInput<double>::FromExpression(
+      parent, "if(t % 3 == 0, 10, t)");
+
+  // Compare with the values of the single timesteps, windows extending
+  // beyond the last change point included.
+  for (int t = 0; t < 16; ++t) {
+    for (int k = 0; k < 16; ++k) {
+      double step_min = 1e299, step_max = -1e299, step_sum = 0;
+      double linear_min = 1e299, linear_max = -1e299, linear_sum = 0;
+      int rounded_min = 1000, rounded_max = -1000;
+      double expr_sum = 0;
+      for (int s = t; s <= t + k; ++s) {
+        step_min = std::min(step_min, step.ValueAt(s));
+        step_max = std::max(step_max, step.ValueAt(s));
+        step_sum += step.ValueAt(s);
+        linear_min = std::min(linear_min, linear.ValueAt(s));
+        linear_max = std::max(linear_max, linear.ValueAt(s));
+        linear_sum += linear.ValueAt(s);
+        rounded_min = std::min(rounded_min, rounded.ValueAt(s));
+        rounded_max = std::max(rounded_max, rounded.ValueAt(s));
+        expr_sum += expr.ValueAt(s);
+      }
+      ASSERT_DOUBLE_EQ(step_min, step.WindowMin(t, k));
+      ASSERT_DOUBLE_EQ(step_max, step.WindowMax(t, k));
+      ASSERT_NEAR(step_sum, step.WindowSum(t, k), 1e-9);
+      ASSERT_DOUBLE_EQ(linear_min, linear.WindowMin(t, k));
+      ASSERT_DOUBLE_EQ(linear_max, linear.WindowMax(t, k));
+      ASSERT_NEAR(linear_sum, linear.WindowSum(t, k), 1e-9);
+      ASSERT_EQ(rounded_min, rounded.WindowMin(t, k));
+      ASSERT_EQ(rounded_max, rounded.WindowMax(t, k));
+      ASSERT_NEAR(expr_sum, expr.WindowSum(t, k), 1e-9);
+    }
+  }
+
+  // Queries do not move the cursor.
+  EXPECT_DOUBLE_EQ(8., DoUpdateValue(step, 3));
+  EXPECT_DOUBLE_EQ(-1., step.WindowMin(0, 20));
+  EXPECT_EQ(2, step.cursor());
+
+  FlexibleInput<double> constant(parent, std::vector<double>({3.}));
+  EXPECT_DOUBLE_EQ(3., constant.WindowMin(4, 100));
+  EXPECT_DOUBLE_EQ(303., constant.WindowSum(4, 100));
+
+  // Not OK, invalid windows or non-numerical type.
+  EXPECT_THROW(step.WindowSum(-1, 2), cyclus::ValueError);
+  EXPECT_THROW(step.WindowMax(1, -2), cyclus::ValueError);
+  EXPECT_THROW(step.WindowMin(1, std::numeric_limits<int>::max()),
+               cyclus::ValueError);
+  FlexibleInput<std::string> names(parent, std::vector<std::string>({"a"}));
+  EXPECT_THROW(names.WindowMin(0, 1), cyclus::ValueError);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, ScheduleFiles) {
+  cyclus::MockSim sim = SetUpMockSim();
+  parent = sim.agent;
+
+  std::vector<double> expected(
+      {1., 1., 1., 2., 2., 2., 3., 3., 3., 3.});
+
+  std::string bin_path = "flexible_input_test_schedule.bin";
+  {
+    std::ofstream bin(bin_path.c_str(), std::ios::binary);
+    bin.write(reinterpret_cast<const char*>(&expected[0]),
+              (expected.size() - 1) * sizeof(double));
+  }
+  std::string csv_path = "flexible_input_test_schedule.csv";
+  {
+    std::ofstream csv(csv_path.c_str());
+    csv << "# time,value\n0,1\n3,2\n\n6,3\n";
+  }
+
+  {
+    FlexibleInput<double> f = FlexibleInput<double>::FromFile(parent,
+                                                              bin_path);
+    FlexibleInput<double> g = FlexibleInput<double>::FromFile(parent,
+                                                              csv_path);
+    for (int t = 0; t < duration; ++t) {
+      EXPECT_DOUBLE_EQ(expected[t], DoUpdateValue(f, t));
+      EXPECT_DOUBLE_EQ(expected[t], f.ValueAt(t));
+      EXPECT_DOUBLE_EQ(expected[t], DoUpdateValue(g, t));
+    }
+    // Values after the end of the file equal the last one.
+    EXPECT_DOUBLE_EQ(1., f.WindowMin(0, 20));
+    EXPECT_DOUBLE_EQ(3., f.WindowMax(5, 20));
+    EXPECT_DOUBLE_EQ(21., f.WindowSum(7, 6));
+    EXPECT_DOUBLE_EQ(12., f.WindowSum(20, 3));
+    // All agents share one mapping and one parsed CSV file.
+    EXPECT_EQ(MappedSeries<double>::Open(bin_path),
+              MappedSeries<double>::Open(bin_path));
+    FlexibleInput<double> h = FlexibleInput<double>::FromFile(parent,
+                                                              csv_path);
+    EXPECT_EQ(1, MappedSeries<double>::n_open());
+    EXPECT_EQ(1, CsvScheduleCache<double>::size());
+  }
+  // The files are released along with the last user.
+  EXPECT_EQ(0, MappedSeries<double>::n_open());
+  EXPECT_EQ(0, CsvScheduleCache<double>::size());
+
+  // One-column files are checked against the lifetime before their runs are
+  // compressed.
+  {
+    std::ofstream csv(csv_path.c_str());
+    for (int t = 0; t < duration; ++t) {
+      csv << "5\n";
+    }
+  }
+  FlexibleInput<double> constant = FlexibleInput<double>::FromFile(
+      parent, csv_path);
+  EXPECT_TRUE(constant.constant());
+  {
+    std::ofstream csv(csv_path.c_str());
+    for (int t = 0; t <= duration; ++t) {
+      csv << "5\n";
+    }
+  }
+  EXPECT_THROW(FlexibleInput<int>::FromFile(parent, csv_path),
+               cyclus::ValueError);
+
+  // Not OK, files do not exist or are malformed.
+  EXPECT_THROW(FlexibleInput<double>::FromFile(parent, "missing.bin"),
+               cyclus::IOError);
+  EXPECT_THROW(FlexibleInput<double>::FromFile(parent, "missing.csv"),
+               cyclus::IOError);
+  {
+    std::ofstream csv(csv_path.c_str());
+    csv << "0,1\n3\n";
+  }
+  EXPECT_THROW(FlexibleInput<int>::FromFile(parent, csv_path),
+               cyclus::ValueError);
+
+  std::remove(bin_path.c_str());
+  std::remove(csv_path.c_str());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, ExpressionSchedule) {
+  cyclus::MockSim sim = SetUpMockSim();
+  parent = sim.agent;
+
+  FlexibleInput<double> f = FlexibleInput<double>::FromExpression(
+      parent, "if(t % 4 == 3, 0, 10 * 2^t)");
+  EXPECT_FALSE(f.constant());
+  std::vector<int> query_times({0, 1, 2, 3, 3, 9, 4, 8});
+  for (int t : query_times) {
+    double expected = t % 4 == 3 ? 0. : 10. * std::pow(2., t);
+    EXPECT_DOUBLE_EQ(expected, DoUpdateValue(f, t));
+    EXPECT_DOUBLE_EQ(expected, f.ValueAt(t));
+  }
+
+  // Integral values are rounded.
+  FlexibleInput<int> g = FlexibleInput<int>::FromExpression(parent, "t / 4");
+  EXPECT_EQ(0, DoUpdateValue(g, 1));
+  EXPECT_EQ(1, DoUpdateValue(g, 2));
+
+  FlexibleInput<double> h = FlexibleInput<double>::FromExpression(
+      parent, "2 * 21");
+  EXPECT_TRUE(h.constant());
+  EXPECT_DOUBLE_EQ(42., h.UpdateValue(parent));
+
+  // Random values depend on the seed and the ensemble member.
+  FlexibleInput<double> r = FlexibleInput<double>::FromExpression(
+      parent, "uniform(0, 1)", 42, 3);
+  FlexibleInput<double> same = FlexibleInput<double>::FromExpression(
+      parent, "uniform(0, 1)", 42, 3);
+  FlexibleInput<double> other = FlexibleInput<double>::FromExpression(
+      parent, "uniform(0, 1)", 42, 4);
+  EXPECT_DOUBLE_EQ(r.ValueAt(5), same.ValueAt(5));
+  EXPECT_NE(r.ValueAt(5), other.ValueAt(5));
+
+  // Not OK, invalid expression or non-numerical type.
+  EXPECT_THROW(FlexibleInput<double>::FromExpression(parent, "2 *"),
+               cyclus::ValueError);
+  EXPECT_THROW(FlexibleInput<std::string>::FromExpression(parent, "t"),
+               cyclus::ValueError);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, ConstantSchedule) {
+  cyclus::MockSim sim = SetUpMockSim();
+  parent = sim.agent;
+
+  FlexibleInput<double> f(parent, std::vector<double>({42.}),
+                          std::vector<int>({0}));
+  EXPECT_TRUE(f.constant());
+  EXPECT_DOUBLE_EQ(42., f.UpdateValue(parent));
+  EXPECT_DOUBLE_EQ(42., f.ValueAt(duration - 1));
+
+  FlexibleInput<double> g(parent, std::vector<double>({42., 43.}),
+                          std::vector<int>({0, 5}));
+  EXPECT_FALSE(g.constant());
+
+  // Not explicitly instantiated in the library.
+  FlexibleInput<bool> h(parent, std::vector<bool>({true}));
+  EXPECT_TRUE(h.UpdateValue(parent));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, SharedSchedule) {
+  cyclus::MockSim sim = SetUpMockSim();
+  parent = sim.agent;
+
+  std::vector<int> time({0, 4, 5, 8});
+  std::vector<double> vals({10., 20., 30., 40.});
+  std::vector<double> other_vals({10., 20., 30., 50.});
+  int n_schedules = ScheduleStore<double>::size();
+  {
+    FlexibleInput<double> f(parent, vals, time);
+    FlexibleInput<double> g(parent, vals, time);
+    EXPECT_EQ(n_schedules + 1, ScheduleStore<double>::size());
+
+    FlexibleInput<double> h(parent, other_vals, time);
+    EXPECT_EQ(n_schedules + 2, ScheduleStore<double>::size());
+
+    // Cursors are not shared.
+    EXPECT_DOUBLE_EQ(40., DoUpdateValue(f, 9));
+    EXPECT_DOUBLE_EQ(10., DoUpdateValue(g, 0));
+    EXPECT_DOUBLE_EQ(50., DoUpdateValue(h, 9));
+
+    // Window tables are only built on the first window query and then shared.
+    ScheduleStore<double>::Ptr schedule = ScheduleStore<double>::Intern(vals,
+                                                                        time);
+    EXPECT_FALSE(schedule->window_tables);
+    EXPECT_DOUBLE_EQ(10., f.WindowMin(0, 3));
+    EXPECT_FALSE(schedule->window_tables);
+    EXPECT_DOUBLE_EQ(40., g.WindowMax(0, 9));
+    ASSERT_TRUE(schedule->window_tables);
+    EXPECT_DOUBLE_EQ(10. * 4 + 20. + 30. * 3, f.WindowSum(0, 7));
+    EXPECT_EQ(2, schedule->window_tables->range_max.size());
+    EXPECT_DOUBLE_EQ(40., schedule->window_tables->range_max[1][0]);
+  }
+  EXPECT_EQ(n_schedules, ScheduleStore<double>::size());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, VectorInput) {
+  cyclus::MockSim sim = SetUpMockSim();
+  parent = sim.agent;
+
+  // Preferences of two commodities changing at t = 0 and t = 4.
+  std::vector<double> vals({1., 2., 3., 0.5});
+  std::vector<int> time({0, 4});
+  FlexibleVectorInput<double> f(parent, 2, vals, time);
+  EXPECT_EQ(2, f.width());
+  EXPECT_TRUE(f.Update(parent));
+  EXPECT_FALSE(f.Update(parent));
+  EXPECT_DOUBLE_EQ(1., f.value(0));
+  EXPECT_DOUBLE_EQ(2., f.value(1));
+  EXPECT_EQ(std::vector<double>({1., 2.}), f.values());
+
+  // Method 2, one vector per timestep. The first vector is available before
+  // the first update.
+  FlexibleVectorInput<double> g(parent, 2, vals);
+  EXPECT_EQ(std::vector<double>({1., 2.}), g.values());
+  EXPECT_TRUE(g.Update(parent));
+  EXPECT_EQ(std::vector<double>({1., 2.}), g.values());
+
+  // Runs of identical vectors are stored once and only their ends are
+  // reported as changes.
+  std::vector<double> runs({1., 2., 1., 2., 1., 2., 3., 0.5, 3., 0.5, 1., 2.});
+  FlexibleVectorInput<double> h(parent, 2, runs);
+  EXPECT_EQ(3, DoVectorSize(h));
+  std::vector<bool> changed({true, false, false, true, false, true});
+  for (int t = 0; t < changed.size(); ++t) {
+    EXPECT_EQ(changed[t], DoUpdateVector(h, t)) << "t = " << t;
+    EXPECT_DOUBLE_EQ(runs[2*t], h.value(0)) << "t = " << t;
+  }
+  std::vector<double> repeated({1., 2., 1., 2., 3., 0.5, 3., 0.5});
+  FlexibleVectorInput<double> k(parent, 2, repeated,
+                                std::vector<int>({0, 2, 4, 6}));
+  EXPECT_EQ(2, DoVectorSize(k));
+  EXPECT_TRUE(DoUpdateVector(k, 0));
+  EXPECT_FALSE(DoUpdateVector(k, 3));
+  EXPECT_TRUE(DoUpdateVector(k, 4));
+  EXPECT_FALSE(DoUpdateVector(k, 7));
+  EXPECT_EQ(std::vector<double>({3., 0.5}), k.values());
+
+  // Not OK, number of values does not match the width.
+  EXPECT_THROW(FlexibleVectorInput<double> bad(parent, 3, vals, time),
+               cyclus::ValueError);
+  EXPECT_THROW(FlexibleVectorInput<double> bad(parent, 0, vals),
+               cyclus::ValueError);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, ScheduleRegistry) {
+  cyclus::MockSim sim = SetUpMockSim();
+  parent = sim.agent;
+  ScheduleRegistry<double>& registry = ScheduleRegistry<double>::Get(
+      parent->context());
+  EXPECT_EQ(0, registry.size());
+
+  FlexibleInput<double> f(parent, std::vector<double>({1., 2., 2., 3.}),
+                          std::vector<int>({0, 3, 5, 7}));
+  FlexibleInput<double> g(parent, std::vector<double>({42.}));
+  {
+    ScheduleSlot<double> f_slot(parent, f);
+    ScheduleSlot<double> g_slot(parent, g);
+    EXPECT_EQ(2, registry.size());
+
+    // Only report actual changes, i.e., not at t = 5 where the schedule
+    // changes to the same value.
+    std::vector<bool> expected({true, false, false, true, false, false, false,
+                                true, false, false});
+    for (int t = 0; t < duration; ++t) {
+      EXPECT_EQ(expected[t], f_slot.Update(t)) << "t = " << t;
+      EXPECT_DOUBLE_EQ(f.ValueAt(t), f_slot.value());
+      EXPECT_EQ(t == 0, g_slot.Update(t));
+      EXPECT_DOUBLE_EQ(42., g_slot.value());
+    }
+
+    // Changes are kept until they are asked for.
+    registry.Advance(0);
+    registry.Advance(4);
+    EXPECT_TRUE(f_slot.Update(4));
+    EXPECT_DOUBLE_EQ(2., f_slot.value());
+
+    // Moving hands the slot over, reassigning releases it.
+    ScheduleSlot<double> moved(std::move(f_slot));
+    EXPECT_TRUE(f_slot.empty());
+    EXPECT_THROW(f_slot.Update(5), cyclus::StateError);
+    EXPECT_EQ(2, registry.size());
+    EXPECT_TRUE(moved.Update(7));
+    EXPECT_DOUBLE_EQ(3., moved.value());
+    g_slot = ScheduleSlot<double>();
+    EXPECT_TRUE(g_slot.empty());
+    EXPECT_EQ(1, registry.size());
+
+    // Releasing a slot in the middle of the pass keeps the others active.
+    FlexibleInput<double> h(parent, std::vector<double>({5., 6.}),
+                            std::vector<int>({0, 8}));
+    ScheduleSlot<double> h_slot(parent, h);
+    ScheduleSlot<double> f2_slot(parent, f);
+    EXPECT_TRUE(h_slot.Update(7));
+    EXPECT_TRUE(f2_slot.Update(7));
+    moved = ScheduleSlot<double>();
+    EXPECT_EQ(2, registry.size());
+    EXPECT_TRUE(h_slot.Update(8));
+    EXPECT_DOUBLE_EQ(6., h_slot.value());
+    EXPECT_TRUE(f2_slot.Update(8));
+    EXPECT_DOUBLE_EQ(3., f2_slot.value());
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, DISABLED_ScheduleSharingBenchmark) {
+  // Resident memory per agent when many clones of one prototype use a dense
+  // schedule (method 2). Each agent still holds the values in its
+  // `*_vals` state variable, only the copy held by its `FlexibleInput`
+  // variable is shared. Each configuration is measured in a fresh process.
+  // Run with `--gtest_also_run_disabled_tests`.
+  const int n_steps = 20000;
+  const int n_agents = 500;
+  cyclus::MockSim sim = SetUpMockSim(n_steps);
+  parent = sim.agent;
+
+  std::vector<double> vals(n_steps);
+  std::iota(vals.begin(), vals.end(), 0.);
+
+  // The state variables (`*_vals`, and `*_times` = [-1]) of each agent.
+  struct StateVars {
+    std::vector<double> vals;
+    std::vector<int> times;
+  };
+
+  // Build the state variables and inputs of all agents. Without sharing,
+  // the schedule of each agent differs in its first value, such that each
+  // `FlexibleInput` holds its own copy of values and times as it did before
+  // schedules were shared.
+  auto measure = [&](bool shared) {
+    double rss_start = test::ResidentMemory();
+    std::vector<StateVars> state;
+    std::vector<FlexibleInput<double> > inputs;
+    state.reserve(n_agents);
+    inputs.reserve(n_agents);
+    for (int i = 0; i < n_agents; ++i) {
+      state.push_back(StateVars{vals, std::vector<int>(1, -1)});
+      if (!shared) {
+        state.back().vals[0] = -1. - i;
+      }
+      inputs.push_back(FlexibleInput<double>(parent, state.back().vals));
+    }
+    double rss = test::ResidentMemory();
+    if (inputs.back().ValueAt(n_steps - 1) != n_steps - 1) {
+      return -1.;  // Failures in the child process would not be reported.
+    }
+    return (rss - rss_start) / n_agents;
+  };
+  double copied = test::MeasureInChild([&]() { return measure(false); });
+  double shared = test::MeasureInChild([&]() { return measure(true); });
+
+  std::cout << "[ BENCH    ] " << n_agents << " agents, " << n_steps
+            << " timesteps, state variables included\n"
+            << "[ BENCH    ] copied schedules: " << copied << " bytes/agent\n"
+            << "[ BENCH    ] shared schedule:  " << shared << " bytes/agent"
+            << std::endl;
+  EXPECT_GT(shared, 0);
+  EXPECT_LT(shared, copied);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST_F(FlexibleInputTest, DISABLED_LookupBenchmark) {
+  // Compare the cost of the different lookups on a schedule with many change
+  // points with the single-step cursor they replaced. Run with
+  // `--gtest_also_run_disabled_tests`.
+  using Clock = std::chrono::steady_clock;
+
+  const int n_changes = 20000;
+  const int n_queries = 2000;
+  cyclus::MockSim sim = SetUpMockSim(n_changes);
+  parent = sim.agent;
+
+  std::vector<double> vals(n_changes);
+  std::iota(vals.begin(), vals.end(), 0.);
+  FlexibleInput<double> f(parent, vals);
+
+  std::vector<int> query_times(n_queries);
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dist(0, n_changes - 1);
+  for (int& t : query_times) {
+    t = dist(gen);
+  }
+
+  std::vector<int> time(n_changes);
+  std::iota(time.begin(), time.end(), 0);
+  test::BaselineCursor<double> baseline(vals, time);
+
+  double checksum = 0;
+  Clock::time_point start = Clock::now();
+  for (int t = 0; t < n_changes; ++t) {
+    checksum += DoUpdateValue(f, t);
+  }
+  double monotone_ns = std::chrono::duration<double, std::nano>(
+      Clock::now() - start).count() / n_changes;
+
+  start = Clock::now();
+  for (int t = 0; t < n_changes; ++t) {
+    checksum += baseline.UpdateValue(t);
+  }
+  double baseline_monotone_ns = std::chrono::duration<double, std::nano>(
+      Clock::now() - start).count() / n_changes;
+
+  start = Clock::now();
+  for (int t : query_times) {
+    checksum += f.ValueAt(t);
+  }
+  double random_ns = std::chrono::duration<double, std::nano>(
+      Clock::now() - start).count() / n_queries;
+
+  // The baseline cursor has to replay every timestep from the beginning to
+  // answer an out-of-order query.
+  start = Clock::now();
+  for (int t : query_times) {
+    baseline.Restart();
+    for (int tt = 0; tt <= t; ++tt) {
+      checksum += baseline.UpdateValue(tt);
+    }
+  }
+  double replay_ns = std::chrono::duration<double, std::nano>(
+      Clock::now() - start).count() / n_queries;
+
+  std::cout << "[ BENCH    ] " << n_changes << " change points\n"
+            << "[ BENCH    ] monotone update:           " << monotone_ns
+            << " ns/lookup\n"
+            << "[ BENCH    ] baseline monotone update:  "
+            << baseline_monotone_ns << " ns/lookup\n"
+            << "[ BENCH    ] random-access lookup:      " << random_ns
+            << " ns/lookup\n"
+            << "[ BENCH    ] baseline replay:           " << replay_ns
+            << " ns/lookup\n"
+            << "[ BENCH    ] (checksum " << checksum << ")" << std::endl;
+  EXPECT_LT(random_ns, replay_ns);
 }
 
 }  // namespace flexicamore
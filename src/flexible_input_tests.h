@@ -4,6 +4,7 @@
 #include <gtest/gtest.h>
 
 #include "flexible_input.h"
+#include "flexible_vector_input.h"
 
 namespace cyclus {
   class Agent;
@@ -18,8 +19,30 @@ class FlexibleInputTest : public ::testing::Test {
   ~FlexibleInputTest();
 
   cyclus::MockSim SetUpMockSim();
+  cyclus::MockSim SetUpMockSim(int sim_duration);
   cyclus::Agent* parent;
   const int duration = 10;
+
+  // See `FlexibleEnrichmentTest` for why these Do* functions are needed.
+  template <typename T>
+  inline T DoUpdateValue(FlexibleInput<T>& f, int t) {
+    return f.UpdateValue_(t);
+  }
+  // Number of change points stored in the schedule.
+  template <typename T>
+  inline std::size_t DoScheduleSize(const FlexibleInput<T>& f) {
+    return f.schedule_->time.size();
+  }
+  // Update `f` to relative time `t`.
+  template <typename T>
+  inline bool DoUpdateVector(FlexibleVectorInput<T>& f, int t) {
+    return f.Update_(f.point_.UpdateValue_(t));
+  }
+  // Number of distinct vectors stored.
+  template <typename T>
+  inline std::size_t DoVectorSize(const FlexibleVectorInput<T>& f) {
+    return f.columns_[0].size();
+  }
 };
 
 }  // namespace flexicamore
@@ -0,0 +1,159 @@
+#ifndef FLEXICAMORE_SRC_FLEXIBLE_VECTOR_INPUT_H_
+#define FLEXICAMORE_SRC_FLEXIBLE_VECTOR_INPUT_H_
+
+#include <cstddef>  // std::size_t
+#include <sstream>
+#include <vector>
+
+#include "agent.h"
+#include "context.h"
+#include "error.h"
+
+#include "flexible_input.h"
+
+namespace flexicamore {
+
+// Time-dependent vector of fixed width, e.g., one preference per commodity.
+//
+// The values are stored structure-of-arrays, i.e., one array per component
+// indexed by change point, and the change point valid at a given time is
+// tracked by a `FlexibleInput<int>` over the change point indices. Runs of
+// identical vectors are stored as one change point. Hence, users can cheaply
+// find out whether the vector changed and only recompute dependent state
+// (such as a sorting by preference) then.
+template <typename T>
+class FlexibleVectorInput {
+ public:
+  FlexibleVectorInput();
+  // Method 2: `value` contains `width` values for each timestep, stored one
+  // timestep after the other.
+  FlexibleVectorInput(cyclus::Agent* parent, std::size_t width,
+                      const std::vector<T>& value);
+  // Method 1: `value` contains `width` values for each change time, stored
+  // one change time after the other.
+  FlexibleVectorInput(cyclus::Agent* parent, std::size_t width,
+                      const std::vector<T>& value, std::vector<int> time);
+
+  // Move to the current time of `parent` and return true if the vector
+  // changed since the last call (always true at the first call).
+  bool Update(cyclus::Agent* parent);
+
+  inline std::size_t width() const { return columns_.size(); }
+  inline bool empty() const { return columns_.empty(); }
+
+  // Component `i` of the current vector, i.e., the first one before the
+  // first call of `Update`.
+  inline T value(std::size_t i) const { return columns_[i][current_]; }
+  // The current vector.
+  std::vector<T> values() const;
+
+  friend class FlexibleInputTest;
+
+ private:
+  // Store the distinct vectors of `value` and return the change point index
+  // of each of its `n_rows` vectors.
+  std::vector<int> Init_(cyclus::Agent* parent, std::size_t width,
+                         const std::vector<T>& value, std::size_t n_rows);
+  // Move to change point `point`, return true if it differs from the last.
+  bool Update_(int point);
+
+  // Change point index valid at a given time.
+  FlexibleInput<int> point_;
+  int current_;
+  bool updated_;  // True once `Update` has been called.
+  // One array per component with one value per change point.
+  std::vector<std::vector<T> > columns_;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+FlexibleVectorInput<T>::FlexibleVectorInput()
+    : current_(0), updated_(false) {}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+FlexibleVectorInput<T>::FlexibleVectorInput(cyclus::Agent* parent,
+                                            std::size_t width,
+                                            const std::vector<T>& value)
+    : current_(0), updated_(false) {
+  std::size_t n_rows = width == 0 ? 0 : value.size() / width;
+  point_ = FlexibleInput<int>(parent, Init_(parent, width, value, n_rows));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+FlexibleVectorInput<T>::FlexibleVectorInput(cyclus::Agent* parent,
+                                            std::size_t width,
+                                            const std::vector<T>& value,
+                                            std::vector<int> time)
+    : current_(0), updated_(false) {
+  std::vector<int> points = Init_(parent, width, value, time.size());
+  point_ = FlexibleInput<int>(parent, points, time);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+std::vector<int> FlexibleVectorInput<T>::Init_(cyclus::Agent* parent,
+                                               std::size_t width,
+                                               const std::vector<T>& value,
+                                               std::size_t n_rows) {
+  if (width == 0 || n_rows == 0 || value.size() != width * n_rows) {
+    std::stringstream ss;
+    ss << "While initialising agent '" << parent->prototype()
+       << "' of spec '" << parent->spec() << "' at time '"
+       << parent->context()->time() << "' a problem appeared:\n"
+       << "expected " << width << " values per change point, but got "
+       << value.size() << " values for " << n_rows << " change points.\n";
+
+    throw cyclus::ValueError(ss.str());
+  }
+
+  columns_ = std::vector<std::vector<T> >(width);
+  std::vector<int> points(n_rows);
+  int point = -1;
+  for (std::size_t row = 0; row < n_rows; ++row) {
+    bool same = point >= 0;
+    for (std::size_t i = 0; same && i < width; ++i) {
+      same = columns_[i][point] == value[row * width + i];
+    }
+    if (!same) {
+      ++point;
+      for (std::size_t i = 0; i < width; ++i) {
+        columns_[i].push_back(value[row * width + i]);
+      }
+    }
+    points[row] = point;
+  }
+  return points;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+bool FlexibleVectorInput<T>::Update(cyclus::Agent* parent) {
+  return Update_(point_.UpdateValue(parent));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+bool FlexibleVectorInput<T>::Update_(int point) {
+  if (updated_ && point == current_) {
+    return false;
+  }
+  updated_ = true;
+  current_ = point;
+  return true;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+std::vector<T> FlexibleVectorInput<T>::values() const {
+  std::vector<T> result(columns_.size());
+  for (std::size_t i = 0; i < columns_.size(); ++i) {
+    result[i] = columns_[i][current_];
+  }
+  return result;
+}
+
+}  // namespace flexicamore
+
+#endif  // FLEXICAMORE_SRC_FLEXIBLE_VECTOR_INPUT_H_
@@ -0,0 +1,457 @@
+#include "schedule_expression.h"
+
+#include <cctype>  // std::isalpha, std::isalnum, std::isdigit, std::isspace
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>  // std::getenv, std::strtod, std::strtoll
+#include <limits>
+#include <sstream>
+
+#include "error.h"
+
+namespace flexicamore {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+ScheduleExpression::ScheduleExpression(const std::string& source)
+    : source_(source), pos_(0), depth_(0), n_draws_(0) {
+  ParseComparison_();
+  SkipWhitespace_();
+  if (pos_ != source_.size()) {
+    Error_("unexpected character");
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double ScheduleExpression::Evaluate(double t, std::uint64_t stream) const {
+  double stack[kMaxStack];
+  int top = 0;
+  for (std::vector<Instruction>::const_iterator it = code_.begin();
+       it != code_.end(); ++it) {
+    switch (it->op) {
+      case kConst:
+        stack[top++] = it->value;
+        break;
+      case kTime:
+        stack[top++] = t;
+        break;
+      case kUniform: {
+        std::uint64_t draw = 2 * static_cast<std::uint64_t>(it->value);
+        double u = Random_(stream, t, draw);
+        top -= 2;
+        stack[top] = stack[top] + u * (stack[top+1] - stack[top]);
+        ++top;
+        break;
+      }
+      case kNormal: {
+        // Box-Muller transform, using 1 - u to avoid log(0).
+        std::uint64_t draw = 2 * static_cast<std::uint64_t>(it->value);
+        double u1 = 1. - Random_(stream, t, draw);
+        double u2 = Random_(stream, t, draw + 1);
+        double z = std::sqrt(-2. * std::log(u1)) * std::cos(2. * M_PI * u2);
+        top -= 2;
+        stack[top] = stack[top] + stack[top+1] * z;
+        ++top;
+        break;
+      }
+      default:
+        int n_args = Arity_(it->op);
+        top -= n_args;
+        stack[top] = Apply_(it->op, &stack[top]);
+        ++top;
+    }
+  }
+  return stack[0];
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool ScheduleExpression::constant() const {
+  // Constant subexpressions are folded, hence the whole program is one
+  // constant if it does not depend on `t`.
+  return code_.size() == 1 && code_[0].op == kConst;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScheduleExpression::ParseComparison_() {
+  ParseSum_();
+  SkipWhitespace_();
+  OpCode op;
+  std::string next = source_.substr(pos_, 2);
+  if (next == "==") {
+    op = kEq;
+  } else if (next == "!=") {
+    op = kNe;
+  } else if (next == "<=") {
+    op = kLe;
+  } else if (next == ">=") {
+    op = kGe;
+  } else if (!next.empty() && next[0] == '<') {
+    op = kLt;
+  } else if (!next.empty() && next[0] == '>') {
+    op = kGt;
+  } else {
+    return;
+  }
+  pos_ += (op == kLt || op == kGt) ? 1 : 2;
+  ParseSum_();
+  Emit_(op, 2);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScheduleExpression::ParseSum_() {
+  ParseProduct_();
+  while (true) {
+    SkipWhitespace_();
+    if (pos_ == source_.size()
+        || (source_[pos_] != '+' && source_[pos_] != '-')) {
+      return;
+    }
+    OpCode op = source_[pos_++] == '+' ? kAdd : kSub;
+    ParseProduct_();
+    Emit_(op, 2);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScheduleExpression::ParseProduct_() {
+  ParseUnary_();
+  while (true) {
+    SkipWhitespace_();
+    if (pos_ == source_.size()) {
+      return;
+    }
+    OpCode op;
+    switch (source_[pos_]) {
+      case '*':
+        op = kMul;
+        break;
+      case '/':
+        op = kDiv;
+        break;
+      case '%':
+        op = kMod;
+        break;
+      default:
+        return;
+    }
+    ++pos_;
+    ParseUnary_();
+    Emit_(op, 2);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScheduleExpression::ParseUnary_() {
+  SkipWhitespace_();
+  if (pos_ < source_.size() && source_[pos_] == '-') {
+    ++pos_;
+    ParseUnary_();
+    Emit_(kNeg, 1);
+  } else if (pos_ < source_.size() && source_[pos_] == '+') {
+    ++pos_;
+    ParseUnary_();
+  } else {
+    ParsePower_();
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScheduleExpression::ParsePower_() {
+  ParsePrimary_();
+  SkipWhitespace_();
+  if (pos_ < source_.size() && source_[pos_] == '^') {
+    ++pos_;
+    // Right-associative and binding weaker than a unary minus on its right,
+    // i.e., `2^-t` is valid.
+    ParseUnary_();
+    Emit_(kPow, 2);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScheduleExpression::ParsePrimary_() {
+  SkipWhitespace_();
+  if (pos_ == source_.size()) {
+    Error_("unexpected end of expression");
+  }
+
+  char c = source_[pos_];
+  if (c == '(') {
+    ++pos_;
+    ParseComparison_();
+    Expect_(')');
+  } else if (std::isdigit(c) || c == '.') {
+    const char* begin = source_.c_str() + pos_;
+    char* end;
+    double value = std::strtod(begin, &end);
+    if (end == begin) {
+      Error_("invalid number");
+    }
+    pos_ += end - begin;
+    Instruction instruction = {kConst, value};
+    code_.push_back(instruction);
+    Emit_(kConst, 0);
+  } else if (std::isalpha(c)) {
+    std::size_t begin = pos_;
+    while (pos_ < source_.size()
+           && (std::isalnum(source_[pos_]) || source_[pos_] == '_')) {
+      ++pos_;
+    }
+    std::string name = source_.substr(begin, pos_ - begin);
+
+    Instruction instruction = {kConst, 0.};
+    if (name == "t") {
+      instruction.op = kTime;
+      code_.push_back(instruction);
+      Emit_(kTime, 0);
+      return;
+    } else if (name == "pi") {
+      instruction.value = M_PI;
+      code_.push_back(instruction);
+      Emit_(kConst, 0);
+      return;
+    } else if (name == "e") {
+      instruction.value = M_E;
+      code_.push_back(instruction);
+      Emit_(kConst, 0);
+      return;
+    }
+
+    OpCode op;
+    if (name == "exp") {
+      op = kExp;
+    } else if (name == "log") {
+      op = kLog;
+    } else if (name == "sqrt") {
+      op = kSqrt;
+    } else if (name == "abs") {
+      op = kAbs;
+    } else if (name == "floor") {
+      op = kFloor;
+    } else if (name == "ceil") {
+      op = kCeil;
+    } else if (name == "sin") {
+      op = kSin;
+    } else if (name == "cos") {
+      op = kCos;
+    } else if (name == "min") {
+      op = kMin;
+    } else if (name == "max") {
+      op = kMax;
+    } else if (name == "if") {
+      op = kIf;
+    } else if (name == "uniform") {
+      op = kUniform;
+    } else if (name == "normal") {
+      op = kNormal;
+    } else {
+      pos_ = begin;
+      Error_("unknown identifier '" + name + "'");
+    }
+
+    int n_args = Arity_(op);
+    Expect_('(');
+    for (int i = 0; i < n_args; ++i) {
+      if (i > 0) {
+        Expect_(',');
+      }
+      ParseComparison_();
+    }
+    Expect_(')');
+    Emit_(op, n_args);
+  } else {
+    Error_("unexpected character");
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScheduleExpression::Emit_(OpCode op, int n_args) {
+  // Operands are pushed by the caller, `kConst` and `kTime` are already part
+  // of the code.
+  if (op == kConst || op == kTime) {
+    if (++depth_ > kMaxStack) {
+      Error_("expression is nested too deeply");
+    }
+    return;
+  } else if (op == kUniform || op == kNormal) {
+    // Never folded, each call site gets its own draw index.
+    depth_ -= n_args - 1;
+    Instruction instruction = {op, static_cast<double>(n_draws_++)};
+    code_.push_back(instruction);
+    return;
+  }
+
+  depth_ -= n_args - 1;
+  std::size_t first = code_.size() - n_args;
+  bool foldable = true;
+  double args[3];
+  for (int i = 0; i < n_args; ++i) {
+    foldable = foldable && code_[first + i].op == kConst;
+    args[i] = code_[first + i].value;
+  }
+  if (foldable) {
+    code_.resize(first);
+    Instruction instruction = {kConst, Apply_(op, args)};
+    code_.push_back(instruction);
+  } else {
+    Instruction instruction = {op, 0.};
+    code_.push_back(instruction);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScheduleExpression::Expect_(char c) {
+  SkipWhitespace_();
+  if (pos_ == source_.size() || source_[pos_] != c) {
+    Error_(std::string("expected '") + c + "'");
+  }
+  ++pos_;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScheduleExpression::SkipWhitespace_() {
+  while (pos_ < source_.size() && std::isspace(source_[pos_])) {
+    ++pos_;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScheduleExpression::Error_(const std::string& msg) const {
+  std::stringstream ss;
+  ss << "Invalid schedule expression '" << source_ << "': " << msg
+     << " at position " << pos_ << ".\n";
+  throw cyclus::ValueError(ss.str());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::uint64_t ScheduleExpression::Stream(std::uint64_t seed,
+                                         std::uint64_t member,
+                                         std::uint64_t agent_id) {
+  return Mix_(seed, member, agent_id);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int ScheduleExpression::EnsembleMember() {
+  const char* env = std::getenv("FLEXICAMORE_ENSEMBLE_MEMBER");
+  if (env == NULL || *env == '\0') {
+    return 0;
+  }
+  char* end;
+  errno = 0;
+  long long member = std::strtoll(env, &end, 10);
+  if (*end != '\0' || errno != 0 || member < 0
+      || member > std::numeric_limits<int>::max()) {
+    std::stringstream ss;
+    ss << "FLEXICAMORE_ENSEMBLE_MEMBER must be a non-negative integer below "
+       << "2^31, but is '" << env << "'.\n";
+    throw cyclus::ValueError(ss.str());
+  }
+  return static_cast<int>(member);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+std::uint64_t ScheduleExpression::Mix_(std::uint64_t key,
+                                       std::uint64_t counter_0,
+                                       std::uint64_t counter_1) {
+  // Each counter is combined with the state and scrambled by the SplitMix64
+  // finaliser, whose output passes the usual statistical test suites.
+  std::uint64_t x = key;
+  std::uint64_t counter[2] = {counter_0, counter_1};
+  for (int i = 0; i < 2; ++i) {
+    x ^= counter[i] + 0x9e3779b97f4a7c15ULL + (x << 6) + (x >> 2);
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+  }
+  return x;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double ScheduleExpression::Random_(std::uint64_t stream, double t,
+                                   std::uint64_t draw) {
+  std::uint64_t x = Mix_(stream, static_cast<std::uint64_t>(
+                                     static_cast<std::int64_t>(std::floor(t))),
+                         draw);
+  // Use the upper 53 bits for a double in [0, 1).
+  return (x >> 11) * (1. / 9007199254740992.);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+int ScheduleExpression::Arity_(OpCode op) {
+  switch (op) {
+    case kConst:
+    case kTime:
+      return 0;
+    case kNeg:
+    case kExp:
+    case kLog:
+    case kSqrt:
+    case kAbs:
+    case kFloor:
+    case kCeil:
+    case kSin:
+    case kCos:
+      return 1;
+    case kIf:
+      return 3;
+    default:
+      return 2;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+double ScheduleExpression::Apply_(OpCode op, const double* args) {
+  switch (op) {
+    case kAdd:
+      return args[0] + args[1];
+    case kSub:
+      return args[0] - args[1];
+    case kMul:
+      return args[0] * args[1];
+    case kDiv:
+      return args[0] / args[1];
+    case kMod:
+      return std::fmod(args[0], args[1]);
+    case kPow:
+      return std::pow(args[0], args[1]);
+    case kNeg:
+      return -args[0];
+    case kEq:
+      return args[0] == args[1];
+    case kNe:
+      return args[0] != args[1];
+    case kLt:
+      return args[0] < args[1];
+    case kLe:
+      return args[0] <= args[1];
+    case kGt:
+      return args[0] > args[1];
+    case kGe:
+      return args[0] >= args[1];
+    case kExp:
+      return std::exp(args[0]);
+    case kLog:
+      return std::log(args[0]);
+    case kSqrt:
+      return std::sqrt(args[0]);
+    case kAbs:
+      return std::fabs(args[0]);
+    case kFloor:
+      return std::floor(args[0]);
+    case kCeil:
+      return std::ceil(args[0]);
+    case kSin:
+      return std::sin(args[0]);
+    case kCos:
+      return std::cos(args[0]);
+    case kMin:
+      return std::fmin(args[0], args[1]);
+    case kMax:
+      return std::fmax(args[0], args[1]);
+    case kIf:
+      return args[0] != 0 ? args[1] : args[2];
+    default:
+      return args[0];
+  }
+}
+
+}  // namespace flexicamore
@@ -0,0 +1,114 @@
+#ifndef FLEXICAMORE_SRC_SCHEDULE_EXPRESSION_H_
+#define FLEXICAMORE_SRC_SCHEDULE_EXPRESSION_H_
+
+#include <cstddef>  // std::size_t
+#include <cstdint>  // std::uint64_t
+#include <string>
+#include <vector>
+
+namespace flexicamore {
+
+// A schedule defined by a formula of the (relative) time `t`, e.g.,
+// `100 * 1.02^t` for exponential growth or `if(t % 12 == 11, 0, 100)` for an
+// outage every twelfth timestep.
+//
+// The expression is compiled once into a small bytecode program that is
+// evaluated on a fixed-size stack, such that a schedule requires O(1) memory
+// independently of the simulation duration. Subexpressions not depending on
+// `t` are folded into constants at compile time.
+//
+// Supported syntax, in order of increasing precedence:
+// - comparisons `==`, `!=`, `<`, `<=`, `>`, `>=` evaluating to 1 or 0,
+// - `+`, `-`,
+// - `*`, `/`, `%` (floating point remainder),
+// - unary `-`,
+// - `^` (power, right-associative),
+// - numbers, `t`, the constants `pi` and `e`, parentheses and the functions
+//   `exp`, `log`, `sqrt`, `abs`, `floor`, `ceil`, `sin`, `cos` (one argument),
+//   `min`, `max` (two arguments) and `if(condition, then, else)`.
+//
+// In addition, the random functions `uniform(low, high)` and
+// `normal(mean, stddev)` are available. They are computed by a counter-based
+// generator from the random stream (see `Stream`), the time and the position
+// of the call in the expression. Hence, they need no state, are reproducible
+// and do not depend on the order in which agents or timesteps are evaluated.
+class ScheduleExpression {
+ public:
+  // Compile `source`, throws a `cyclus::ValueError` if it is not a valid
+  // expression.
+  explicit ScheduleExpression(const std::string& source);
+
+  // Evaluate at time `t` using random stream `stream` (if the expression
+  // contains random functions).
+  double Evaluate(double t, std::uint64_t stream = 0) const;
+
+  // Random stream of one agent, derived from a user-defined `seed`, the
+  // ensemble `member` and the agent's id, such that each member of an
+  // ensemble run from one input file gets independent streams.
+  static std::uint64_t Stream(std::uint64_t seed, std::uint64_t member,
+                              std::uint64_t agent_id);
+
+  // Ensemble member given by the environment variable
+  // FLEXICAMORE_ENSEMBLE_MEMBER, 0 if it is not set. Throws a
+  // `cyclus::ValueError` if it is not an integer in [0, 2^31).
+  static int EnsembleMember();
+
+  // True if the expression does not depend on `t`.
+  bool constant() const;
+
+  inline const std::string& source() const { return source_; }
+  // Number of bytecode instructions, mostly useful for testing.
+  inline std::size_t size() const { return code_.size(); }
+
+ private:
+  enum OpCode {
+    kConst, kTime,
+    kAdd, kSub, kMul, kDiv, kMod, kPow, kNeg,
+    kEq, kNe, kLt, kLe, kGt, kGe,
+    kExp, kLog, kSqrt, kAbs, kFloor, kCeil, kSin, kCos,
+    kMin, kMax, kIf,
+    kUniform, kNormal
+  };
+
+  struct Instruction {
+    OpCode op;
+    double value;  // Constant (kConst) or draw index (kUniform, kNormal).
+  };
+
+  // Maximum stack depth that can be reached during evaluation.
+  static const int kMaxStack = 64;
+
+  // Recursive descent parser, each function parses one precedence level and
+  // emits the bytecode of the parsed subexpression.
+  void ParseComparison_();
+  void ParseSum_();
+  void ParseProduct_();
+  void ParseUnary_();
+  void ParsePower_();
+  void ParsePrimary_();
+
+  // Append the operation `op` taking `n_args` operands from the stack, or
+  // fold it if all operands are constants.
+  void Emit_(OpCode op, int n_args);
+  void Expect_(char c);
+  void SkipWhitespace_();
+  [[noreturn]] void Error_(const std::string& msg) const;
+
+  static int Arity_(OpCode op);
+  static double Apply_(OpCode op, const double* args);
+  // Hash of the key and the two counters, used as counter-based generator.
+  static std::uint64_t Mix_(std::uint64_t key, std::uint64_t counter_0,
+                            std::uint64_t counter_1);
+  // Uniform random number in [0, 1) being a pure function of its arguments.
+  static double Random_(std::uint64_t stream, double t, std::uint64_t draw);
+
+  std::string source_;
+  std::size_t pos_;  // Current position while parsing.
+  int depth_;  // Current stack depth while parsing.
+  int n_draws_;  // Number of random function calls.
+  std::vector<Instruction> code_;
+};
+
+}  // namespace flexicamore
+
+#endif  // FLEXICAMORE_SRC_SCHEDULE_EXPRESSION_H_
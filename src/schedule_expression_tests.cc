@@ -0,0 +1,143 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <cstdint>  // std::uint64_t
+#include <cstdlib>  // setenv, unsetenv
+#include <string>
+#include <vector>
+
+#include "error.h"
+
+#include "schedule_expression.h"
+
+namespace flexicamore {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ScheduleExpressionTest, Arithmetic) {
+  EXPECT_DOUBLE_EQ(7., ScheduleExpression("1 + 2 * 3").Evaluate(0));
+  EXPECT_DOUBLE_EQ(9., ScheduleExpression("(1 + 2) * 3").Evaluate(0));
+  EXPECT_DOUBLE_EQ(-1., ScheduleExpression("1 - 2").Evaluate(0));
+  EXPECT_DOUBLE_EQ(2.5, ScheduleExpression("5 / 2").Evaluate(0));
+  EXPECT_DOUBLE_EQ(1., ScheduleExpression("7 % 3").Evaluate(0));
+  // Power is right-associative and binds stronger than unary minus.
+  EXPECT_DOUBLE_EQ(512., ScheduleExpression("2^3^2").Evaluate(0));
+  EXPECT_DOUBLE_EQ(-4., ScheduleExpression("-2^2").Evaluate(0));
+  EXPECT_DOUBLE_EQ(0.25, ScheduleExpression("2^-2").Evaluate(0));
+  EXPECT_DOUBLE_EQ(1e3, ScheduleExpression("1e3").Evaluate(0));
+  EXPECT_DOUBLE_EQ(M_PI, ScheduleExpression("pi").Evaluate(0));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ScheduleExpressionTest, Functions) {
+  ScheduleExpression growth("100 * exp(log(1.02) * t)");
+  for (int t = 0; t < 50; ++t) {
+    EXPECT_NEAR(100 * std::pow(1.02, t), growth.Evaluate(t), 1e-9);
+  }
+
+  ScheduleExpression outage("if(t % 12 == 11, 0, 100)");
+  for (int t = 0; t < 50; ++t) {
+    EXPECT_DOUBLE_EQ(t % 12 == 11 ? 0. : 100., outage.Evaluate(t));
+  }
+
+  ScheduleExpression ramp("min(max(10 * (t - 5), 0), 100)");
+  EXPECT_DOUBLE_EQ(0., ramp.Evaluate(2));
+  EXPECT_DOUBLE_EQ(50., ramp.Evaluate(10));
+  EXPECT_DOUBLE_EQ(100., ramp.Evaluate(30));
+
+  EXPECT_DOUBLE_EQ(3., ScheduleExpression("floor(3.7)").Evaluate(0));
+  EXPECT_DOUBLE_EQ(4., ScheduleExpression("ceil(3.2)").Evaluate(0));
+  EXPECT_DOUBLE_EQ(2., ScheduleExpression("abs(-2)").Evaluate(0));
+  EXPECT_DOUBLE_EQ(3., ScheduleExpression("sqrt(9)").Evaluate(0));
+  EXPECT_DOUBLE_EQ(1., ScheduleExpression("(t >= 2) + (t < 1)").Evaluate(0));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ScheduleExpressionTest, ConstantFolding) {
+  ScheduleExpression c("2 * (3 + 4) ^ 2");
+  EXPECT_TRUE(c.constant());
+  EXPECT_EQ(1, c.size());
+  EXPECT_DOUBLE_EQ(98., c.Evaluate(5));
+
+  // Only `10 * exp(1)` can be folded: [t, 10e, *].
+  ScheduleExpression f("t * (10 * exp(1))");
+  EXPECT_FALSE(f.constant());
+  EXPECT_EQ(3, f.size());
+  EXPECT_DOUBLE_EQ(20 * M_E, f.Evaluate(2));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ScheduleExpressionTest, RandomFunctions) {
+  ScheduleExpression e("normal(100, 10) + 0 * uniform(0, 1)");
+  EXPECT_FALSE(e.constant());
+
+  // Values only depend on stream and time, not on the evaluation order.
+  std::uint64_t stream = ScheduleExpression::Stream(42, 0, 7);
+  std::vector<double> forward;
+  for (int t = 0; t < 100; ++t) {
+    forward.push_back(e.Evaluate(t, stream));
+  }
+  for (int t = 99; t >= 0; --t) {
+    EXPECT_DOUBLE_EQ(forward[t], e.Evaluate(t, stream));
+  }
+  EXPECT_NE(forward[0], forward[1]);
+  EXPECT_NE(forward[0], e.Evaluate(0, ScheduleExpression::Stream(42, 0, 8)));
+  EXPECT_NE(forward[0], e.Evaluate(0, ScheduleExpression::Stream(43, 0, 7)));
+
+  // Rough check of the distributions.
+  ScheduleExpression u("uniform(2, 4)");
+  ScheduleExpression n("normal(1, 2)");
+  int n_samples = 100000;
+  double u_sum = 0, n_sum = 0, n_sum_sq = 0;
+  for (int t = 0; t < n_samples; ++t) {
+    double u_val = u.Evaluate(t, stream);
+    ASSERT_LE(2., u_val);
+    ASSERT_GT(4., u_val);
+    u_sum += u_val;
+    double n_val = n.Evaluate(t, stream);
+    n_sum += n_val;
+    n_sum_sq += n_val * n_val;
+  }
+  double n_mean = n_sum / n_samples;
+  EXPECT_NEAR(3., u_sum / n_samples, 0.01);
+  EXPECT_NEAR(1., n_mean, 0.03);
+  EXPECT_NEAR(4., n_sum_sq / n_samples - n_mean * n_mean, 0.1);
+
+  // Ensemble members get different streams.
+  std::uint64_t member_stream = ScheduleExpression::Stream(42, 3, 7);
+  EXPECT_NE(stream, member_stream);
+  EXPECT_EQ(member_stream, ScheduleExpression::Stream(42, 3, 7));
+
+  // The member is read from the environment.
+  EXPECT_EQ(0, ScheduleExpression::EnsembleMember());
+  setenv("FLEXICAMORE_ENSEMBLE_MEMBER", "3", 1);
+  EXPECT_EQ(3, ScheduleExpression::EnsembleMember());
+  setenv("FLEXICAMORE_ENSEMBLE_MEMBER", "three", 1);
+  EXPECT_THROW(ScheduleExpression::EnsembleMember(), cyclus::ValueError);
+  setenv("FLEXICAMORE_ENSEMBLE_MEMBER", "-1", 1);
+  EXPECT_THROW(ScheduleExpression::EnsembleMember(), cyclus::ValueError);
+  setenv("FLEXICAMORE_ENSEMBLE_MEMBER", "4294967296", 1);
+  EXPECT_THROW(ScheduleExpression::EnsembleMember(), cyclus::ValueError);
+  unsetenv("FLEXICAMORE_ENSEMBLE_MEMBER");
+  EXPECT_EQ(0, ScheduleExpression::EnsembleMember());
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(ScheduleExpressionTest, InvalidExpressions) {
+  EXPECT_THROW(ScheduleExpression(""), cyclus::ValueError);
+  EXPECT_THROW(ScheduleExpression("1 +"), cyclus::ValueError);
+  EXPECT_THROW(ScheduleExpression("(1 + 2"), cyclus::ValueError);
+  EXPECT_THROW(ScheduleExpression("1 2"), cyclus::ValueError);
+  EXPECT_THROW(ScheduleExpression("x * 2"), cyclus::ValueError);
+  EXPECT_THROW(ScheduleExpression("min(1)"), cyclus::ValueError);
+  EXPECT_THROW(ScheduleExpression("exp 1"), cyclus::ValueError);
+  EXPECT_THROW(ScheduleExpression("1 $ 2"), cyclus::ValueError);
+  std::string nested = std::string(100, '(') + "t" + std::string(100, ')');
+  EXPECT_NO_THROW(ScheduleExpression e(nested));
+  std::string deep = "t";
+  for (int i = 0; i < 100; ++i) {
+    deep = "t + (" + deep + ")";
+  }
+  EXPECT_THROW(ScheduleExpression e(deep), cyclus::ValueError);
+}
+
+}  // namespace flexicamore
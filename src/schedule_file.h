@@ -0,0 +1,322 @@
+#ifndef FLEXICAMORE_SRC_SCHEDULE_FILE_H_
+#define FLEXICAMORE_SRC_SCHEDULE_FILE_H_
+
+#include <cstddef>  // std::size_t
+#include <fstream>
+#include <map>
+#include <memory>  // std::shared_ptr, std::weak_ptr
+#include <sstream>
+#include <string>
+#include <utility>  // std::make_pair, std::move
+#include <vector>
+
+#include <boost/interprocess/exceptions.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "error.h"
+
+#include "schedule_store.h"
+
+namespace flexicamore {
+
+// True if `path` refers to a CSV schedule file, else it is treated as a
+// binary one.
+inline bool IsCsvScheduleFile(const std::string& path) {
+  const std::string ext = ".csv";
+  return path.size() >= ext.size()
+         && path.compare(path.size() - ext.size(), ext.size(), ext) == 0;
+}
+
+// Read-only view of a binary schedule file. The file contains the raw values
+// (type `T`, native byte order, no header) of consecutive timesteps, i.e., it
+// corresponds to method 2 of `FlexibleInput`.
+//
+// The file is memory-mapped instead of being read, such that only the pages
+// around the current timestep are loaded by the operating system. All agents
+// of a simulation using the same file share one mapping, and concurrent
+// simulations on one node share the pages through the page cache.
+template <typename T>
+class MappedSeries {
+ public:
+  typedef std::shared_ptr<const MappedSeries<T> > Ptr;
+
+  // Return the mapping of `path`, creating it if it does not exist yet.
+  static Ptr Open(const std::string& path);
+
+  // Number of files currently mapped.
+  static std::size_t n_open();
+
+  inline std::size_t size() const { return size_; }
+  inline const T& operator[](std::size_t i) const { return data_[i]; }
+
+ private:
+  typedef std::map<std::string, std::weak_ptr<const MappedSeries<T> > >
+      Registry;
+
+  // Unmaps a file and erases its entry from the registry.
+  struct Deleter {
+    std::string path;
+    void operator()(const MappedSeries<T>* series) const;
+  };
+
+  explicit MappedSeries(const std::string& path);
+
+  static Registry& Registry_();
+
+  boost::interprocess::file_mapping file_;
+  boost::interprocess::mapped_region region_;
+  const T* data_;
+  std::size_t size_;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+typename MappedSeries<T>::Ptr MappedSeries<T>::Open(const std::string& path) {
+  Registry& registry = Registry_();
+  typename Registry::iterator it = registry.find(path);
+  if (it != registry.end()) {
+    Ptr series = it->second.lock();
+    if (series) {
+      return series;
+    }
+  }
+
+  Ptr series(new MappedSeries<T>(path), Deleter{path});
+  registry[path] = series;
+  return series;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+std::size_t MappedSeries<T>::n_open() {
+  // Expired entries erase themselves, see `Deleter`.
+  return Registry_().size();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void MappedSeries<T>::Deleter::operator()(
+    const MappedSeries<T>* series) const {
+  Registry& registry = Registry_();
+  typename Registry::iterator it = registry.find(path);
+  if (it != registry.end() && it->second.expired()) {
+    registry.erase(it);
+  }
+  delete series;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+typename MappedSeries<T>::Registry& MappedSeries<T>::Registry_() {
+  static Registry registry;
+  return registry;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+MappedSeries<T>::MappedSeries(const std::string& path)
+    : data_(NULL), size_(0) {
+  namespace bi = boost::interprocess;
+
+  try {
+    bi::file_mapping file(path.c_str(), bi::read_only);
+    bi::mapped_region region(file, bi::read_only);
+    file_.swap(file);
+    region_.swap(region);
+  } catch (bi::interprocess_exception& e) {
+    std::stringstream ss;
+    ss << "Cannot map schedule file '" << path << "': " << e.what() << "\n";
+    throw cyclus::IOError(ss.str());
+  }
+  if (region_.get_size() == 0 || region_.get_size() % sizeof(T) != 0) {
+    std::stringstream ss;
+    ss << "Schedule file '" << path << "' has a size of "
+       << region_.get_size() << " bytes which is not a positive multiple of "
+       << "the value size (" << sizeof(T) << " bytes).\n";
+    throw cyclus::ValueError(ss.str());
+  }
+  // Timesteps are (usually) accessed in order.
+  region_.advise(bi::mapped_region::advice_sequential);
+
+  data_ = static_cast<const T*>(region_.get_address());
+  size_ = region_.get_size() / sizeof(T);
+}
+
+// Cache of the parsed CSV schedule files, see `ReadCsvSchedule`. The cache
+// only refers to the schedules, entries erase themselves once the last
+// `FlexibleInput` using them is gone.
+template <typename T>
+class CsvScheduleCache {
+ public:
+  typedef typename ScheduleStore<T>::Ptr Ptr;
+  typedef std::pair<std::string, Interpolation> Key;
+
+  // Return the cached schedule of `key` or an empty pointer if there is
+  // none. `n_timesteps` is set to the value stored along with it.
+  static Ptr Find(const Key& key, std::size_t* n_timesteps);
+
+  // Cache `schedule` under `key` and return the pointer to hand out to its
+  // users.
+  static Ptr Insert(const Key& key, Ptr schedule, std::size_t n_timesteps);
+
+  // Number of files currently cached.
+  static std::size_t size();
+
+ private:
+  struct Entry {
+    std::weak_ptr<const Schedule<T> > schedule;
+    std::size_t n_timesteps;
+  };
+  typedef std::map<Key, Entry> Cache;
+
+  // Erases the entry of a schedule from the cache. It holds the reference to
+  // the interned schedule, which is released along with the deleter.
+  struct Deleter {
+    Key key;
+    Ptr schedule;
+    void operator()(const Schedule<T>* ptr) const;
+  };
+
+  static Cache& Cache_();
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+typename CsvScheduleCache<T>::Ptr CsvScheduleCache<T>::Find(
+    const Key& key, std::size_t* n_timesteps) {
+  Cache& cache = Cache_();
+  typename Cache::iterator it = cache.find(key);
+  if (it == cache.end()) {
+    return Ptr();
+  }
+  *n_timesteps = it->second.n_timesteps;
+  return it->second.schedule.lock();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+typename CsvScheduleCache<T>::Ptr CsvScheduleCache<T>::Insert(
+    const Key& key, Ptr schedule, std::size_t n_timesteps) {
+  const Schedule<T>* raw = schedule.get();
+  Ptr ptr(raw, Deleter{key, std::move(schedule)});
+  Cache_()[key] = Entry{ptr, n_timesteps};
+  return ptr;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+std::size_t CsvScheduleCache<T>::size() {
+  // Expired entries erase themselves, see `Deleter`.
+  return Cache_().size();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void CsvScheduleCache<T>::Deleter::operator()(
+    const Schedule<T>* ptr) const {
+  // `ptr` is owned by the `ScheduleStore`, only the entry goes.
+  Cache& cache = Cache_();
+  typename Cache::iterator it = cache.find(key);
+  if (it != cache.end() && it->second.schedule.expired()) {
+    cache.erase(it);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+typename CsvScheduleCache<T>::Cache& CsvScheduleCache<T>::Cache_() {
+  static Cache cache;
+  return cache;
+}
+
+// Parse a CSV schedule file. Empty lines and lines starting with '#' are
+// ignored. Files with one column contain one value per timestep (method 2 of
+// `FlexibleInput`), files with two columns contain pairs of change times and
+// values (method 1).
+//
+// One-column files are run-length compressed, `n_timesteps` is set to their
+// number of rows before compression such that callers can check it against
+// the lifetime of the agent. It is set to 0 for two-column files.
+//
+// Each file is parsed only once as long as a schedule read from it is in
+// use, the schedules are shared via the `ScheduleStore`.
+template <typename T>
+typename ScheduleStore<T>::Ptr ReadCsvSchedule(
+    const std::string& path, Interpolation interpolation,
+    std::size_t* n_timesteps) {
+  typedef typename ScheduleStore<T>::Ptr Ptr;
+
+  typename CsvScheduleCache<T>::Key key = std::make_pair(path,
+                                                         interpolation);
+  Ptr schedule = CsvScheduleCache<T>::Find(key, n_timesteps);
+  if (schedule) {
+    return schedule;
+  }
+
+  std::ifstream file(path.c_str());
+  if (!file) {
+    std::stringstream ss;
+    ss << "Cannot open schedule file '" << path << "'.\n";
+    throw cyclus::IOError(ss.str());
+  }
+
+  std::vector<T> value;
+  std::vector<int> time;
+  int n_columns = 0;
+  int line_number = 0;
+  std::string line;
+  while (std::getline(file, line)) {
+    ++line_number;
+    if (line.empty() || line[0] == '#' || line == "\r") {
+      continue;
+    }
+    std::stringstream row(line);
+    std::vector<std::string> cells;
+    std::string cell;
+    while (std::getline(row, cell, ',')) {
+      cells.push_back(cell);
+    }
+    if (n_columns == 0) {
+      n_columns = cells.size();
+    }
+
+    T val;
+    int t;
+    std::stringstream val_ss(cells.back());
+    bool ok = (cells.size() == n_columns) && (n_columns == 1
+                                              || n_columns == 2);
+    ok = ok && (val_ss >> val);
+    if (ok && n_columns == 2) {
+      std::stringstream time_ss(cells.front());
+      ok = static_cast<bool>(time_ss >> t);
+      time.push_back(t);
+    }
+    if (!ok) {
+      std::stringstream ss;
+      ss << "Schedule file '" << path << "', line " << line_number
+         << ": expected 'value' or 'time,value' but got '" << line << "'.\n";
+      throw cyclus::ValueError(ss.str());
+    }
+    value.push_back(val);
+  }
+  if (value.empty()) {
+    std::stringstream ss;
+    ss << "Schedule file '" << path << "' does not contain any values.\n";
+    throw cyclus::ValueError(ss.str());
+  }
+  *n_timesteps = 0;
+  if (n_columns == 1) {
+    *n_timesteps = value.size();
+    CompressRuns(&value, &time);
+    interpolation = Interpolation::kStep;
+  }
+
+  schedule = ScheduleStore<T>::Intern(std::move(value), std::move(time),
+                                      interpolation);
+  return CsvScheduleCache<T>::Insert(key, std::move(schedule), *n_timesteps);
+}
+
+}  // namespace flexicamore
+
+#endif  // FLEXICAMORE_SRC_SCHEDULE_FILE_H_
@@ -0,0 +1,287 @@
+#ifndef FLEXICAMORE_SRC_SCHEDULE_REGISTRY_H_
+#define FLEXICAMORE_SRC_SCHEDULE_REGISTRY_H_
+
+#include <algorithm>  // std::max
+#include <cstddef>  // std::size_t
+#include <map>
+#include <memory>  // std::unique_ptr
+#include <utility>  // std::make_pair, std::move
+#include <vector>
+
+#include "agent.h"
+#include "context.h"
+#include "error.h"
+
+#include "flexible_input.h"
+
+namespace flexicamore {
+
+template <typename T>
+class ScheduleSlot;
+
+// The ScheduleRegistry advances all `FlexibleInput` variables of one
+// simulation in a single pass per timestep and keeps track of which values
+// changed, such that agents only need to recompute dependent state (e.g.,
+// capacities) at the change points of their schedules.
+//
+// The pass is triggered by the first agent asking for its value in a
+// timestep. Agents do not use the registry directly but via a
+// `ScheduleSlot`.
+template <typename T>
+class ScheduleRegistry {
+ public:
+  // The registry of the simulation that `ctx` belongs to.
+  static ScheduleRegistry<T>& Get(cyclus::Context* ctx);
+
+  // Advance all schedules to simulation time `time` unless this has already
+  // been done.
+  void Advance(int time);
+
+  // Number of registered schedules.
+  inline std::size_t size() const { return n_used_; }
+
+ private:
+  friend class ScheduleSlot<T>;
+
+  explicit ScheduleRegistry(cyclus::Context* ctx);
+
+  std::size_t Register_(cyclus::Agent* parent, const FlexibleInput<T>& input);
+  void Unregister_(std::size_t slot);
+  // Return true if the value in `slot` changed since the last call.
+  bool TakeChanged_(std::size_t slot);
+
+  typedef std::map<cyclus::Context*, std::unique_ptr<ScheduleRegistry<T> > >
+      Registries;
+  static Registries& Registries_();
+
+  cyclus::Context* ctx_;
+  int time_;  // Simulation time of the last `Advance`.
+  std::size_t n_used_;
+
+  // Per-slot data, stored as separate arrays such that the per-timestep pass
+  // only touches what it needs.
+  std::vector<FlexibleInput<T> > inputs_;
+  std::vector<int> enter_times_;
+  std::vector<T> values_;
+  std::vector<char> changed_;
+  // Slots whose value can change, i.e., the ones the pass iterates over, and
+  // the position of each slot in `active_` (`kInactive` if it is not).
+  std::vector<std::size_t> active_;
+  std::vector<std::size_t> active_pos_;
+  static constexpr std::size_t kInactive = static_cast<std::size_t>(-1);
+  std::vector<std::size_t> free_;
+};
+
+// Handle of one `FlexibleInput` registered in the `ScheduleRegistry`. The
+// schedule is unregistered when the handle is destroyed or reassigned.
+// Handles are move-only, a moved-from handle is empty.
+template <typename T>
+class ScheduleSlot {
+ public:
+  ScheduleSlot();
+  // Register a copy of `input`. Its time is measured relative to the entry
+  // of `parent` into the simulation.
+  ScheduleSlot(cyclus::Agent* parent, const FlexibleInput<T>& input);
+  ScheduleSlot(const ScheduleSlot<T>& other) = delete;
+  ScheduleSlot(ScheduleSlot<T>&& other);
+  ScheduleSlot<T>& operator=(const ScheduleSlot<T>& other) = delete;
+  ScheduleSlot<T>& operator=(ScheduleSlot<T>&& other);
+  ~ScheduleSlot();
+
+  // Bring the value up to date with simulation time `time` (usually the
+  // current time) and return true if it changed since the last call (always
+  // true at the first call).
+  bool Update(int time);
+
+  inline T value() const { return Registry_()->values_[slot_]; }
+  // Position in the registered schedule, see `FlexibleInput::cursor`.
+  inline std::size_t cursor() const {
+    return Registry_()->inputs_[slot_].cursor();
+  }
+  inline bool empty() const { return registry_ == NULL; }
+
+ private:
+  // The registry of a non-empty handle.
+  ScheduleRegistry<T>* Registry_() const;
+  void Release_();
+
+  ScheduleRegistry<T>* registry_;
+  std::size_t slot_;
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+ScheduleRegistry<T>::ScheduleRegistry(cyclus::Context* ctx)
+    : ctx_(ctx), time_(-1), n_used_(0) {}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+ScheduleRegistry<T>& ScheduleRegistry<T>::Get(cyclus::Context* ctx) {
+  Registries& registries = Registries_();
+  typename Registries::iterator it = registries.find(ctx);
+  if (it == registries.end()) {
+    it = registries.insert(std::make_pair(
+        ctx, std::unique_ptr<ScheduleRegistry<T> >(
+                 new ScheduleRegistry<T>(ctx)))).first;
+  }
+  return *it->second;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void ScheduleRegistry<T>::Advance(int time) {
+  if (time == time_) {
+    return;
+  }
+  time_ = time;
+  for (std::vector<std::size_t>::const_iterator it = active_.begin();
+       it != active_.end(); ++it) {
+    std::size_t slot = *it;
+    int t = time - enter_times_[slot];
+    if (t < 0) {
+      continue;
+    }
+    T value = inputs_[slot].UpdateValue_(t);
+    if (!(value == values_[slot])) {
+      values_[slot] = value;
+      changed_[slot] = true;
+    }
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+std::size_t ScheduleRegistry<T>::Register_(cyclus::Agent* parent,
+                                           const FlexibleInput<T>& input) {
+  std::size_t slot;
+  if (free_.empty()) {
+    slot = inputs_.size();
+    inputs_.push_back(input);
+    enter_times_.push_back(0);
+    values_.push_back(T());
+    changed_.push_back(true);
+    active_pos_.push_back(kInactive);
+  } else {
+    slot = free_.back();
+    free_.pop_back();
+    inputs_[slot] = input;
+  }
+  ++n_used_;
+  changed_[slot] = true;
+  enter_times_[slot] = parent->enter_time();
+
+  int t = std::max(0, parent->context()->time() - parent->enter_time());
+  values_[slot] = inputs_[slot].constant() ? inputs_[slot].UpdateValue(parent)
+                                           : inputs_[slot].UpdateValue_(t);
+  if (!inputs_[slot].constant()) {
+    active_pos_[slot] = active_.size();
+    active_.push_back(slot);
+  }
+  return slot;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void ScheduleRegistry<T>::Unregister_(std::size_t slot) {
+  std::size_t pos = active_pos_[slot];
+  if (pos != kInactive) {
+    // The pass does not depend on the order of the slots, swap-remove.
+    active_[pos] = active_.back();
+    active_pos_[active_[pos]] = pos;
+    active_.pop_back();
+    active_pos_[slot] = kInactive;
+  }
+  inputs_[slot] = FlexibleInput<T>();
+  free_.push_back(slot);
+  if (--n_used_ == 0) {
+    // Do not keep registries of finished simulations around. This destroys
+    // the registry, so it must come last.
+    Registries_().erase(ctx_);
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+bool ScheduleRegistry<T>::TakeChanged_(std::size_t slot) {
+  bool changed = changed_[slot];
+  changed_[slot] = false;
+  return changed;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+typename ScheduleRegistry<T>::Registries& ScheduleRegistry<T>::Registries_() {
+  static Registries registries;
+  return registries;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+ScheduleSlot<T>::ScheduleSlot() : registry_(NULL), slot_(0) {}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+ScheduleSlot<T>::ScheduleSlot(cyclus::Agent* parent,
+                              const FlexibleInput<T>& input)
+    : registry_(&ScheduleRegistry<T>::Get(parent->context())) {
+  slot_ = registry_->Register_(parent, input);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+ScheduleSlot<T>::ScheduleSlot(ScheduleSlot<T>&& other)
+    : registry_(other.registry_), slot_(other.slot_) {
+  other.registry_ = NULL;
+  other.slot_ = 0;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+ScheduleSlot<T>& ScheduleSlot<T>::operator=(ScheduleSlot<T>&& other) {
+  if (this != &other) {
+    Release_();
+    registry_ = other.registry_;
+    slot_ = other.slot_;
+    other.registry_ = NULL;
+    other.slot_ = 0;
+  }
+  return *this;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+ScheduleSlot<T>::~ScheduleSlot() {
+  Release_();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+bool ScheduleSlot<T>::Update(int time) {
+  ScheduleRegistry<T>* registry = Registry_();
+  registry->Advance(time);
+  return registry->TakeChanged_(slot_);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+ScheduleRegistry<T>* ScheduleSlot<T>::Registry_() const {
+  if (registry_ == NULL) {
+    throw cyclus::StateError("ScheduleSlot: the slot is empty");
+  }
+  return registry_;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void ScheduleSlot<T>::Release_() {
+  if (registry_ != NULL) {
+    // Clear the handle first, the registry may be destroyed by the call.
+    ScheduleRegistry<T>* registry = registry_;
+    registry_ = NULL;
+    registry->Unregister_(slot_);
+  }
+}
+
+}  // namespace flexicamore
+
+#endif  // FLEXICAMORE_SRC_SCHEDULE_REGISTRY_H_
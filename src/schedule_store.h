@@ -0,0 +1,241 @@
+#ifndef FLEXICAMORE_SRC_SCHEDULE_STORE_H_
+#define FLEXICAMORE_SRC_SCHEDULE_STORE_H_
+
+#include <algorithm>  // std::min, std::max
+#include <cstddef>  // std::size_t
+#include <functional>  // std::hash
+#include <memory>  // std::shared_ptr, std::unique_ptr, std::weak_ptr
+#include <type_traits>  // std::is_arithmetic
+#include <unordered_map>
+#include <utility>  // std::move
+#include <vector>
+
+namespace flexicamore {
+
+// How values are determined between two change points of a schedule:
+// - kStep: the value is kept until the next change point,
+// - kLinear: the value is interpolated linearly between the change points.
+enum class Interpolation { kStep, kLinear };
+
+// Tables for window queries (see `FlexibleInput::WindowSum` etc.) over the
+// values of a schedule:
+// - prefix_sum[i]: sum of the values of all timesteps before time[i],
+// - range_min[j-1][i], range_max[j-1][i]: minimum and maximum of the 2^j
+//   values starting at value[i] (sparse tables, the 2^0 values are the
+//   schedule values themselves).
+template <typename T>
+struct WindowTables {
+  std::vector<double> prefix_sum;
+  std::vector<std::vector<T> > range_min;
+  std::vector<std::vector<T> > range_max;
+};
+
+// Immutable content of a `FlexibleInput` variable: the values and the
+// (relative) times at which they become valid.
+template <typename T>
+struct Schedule {
+  std::vector<T> value;
+  std::vector<int> time;
+  Interpolation interpolation;
+
+  // Built on the first window query, see `GetWindowTables`. Most schedules
+  // are never queried over a window and do not pay for the tables.
+  mutable std::unique_ptr<const WindowTables<T> > window_tables;
+};
+
+// Sum of the values of the first `n` timesteps of the segment starting at
+// change point `idx`. Linear interpolation uses the unrounded values.
+template <typename T>
+double SegmentSum(const Schedule<T>& schedule, std::size_t idx, int n) {
+  double value = schedule.value[idx];
+  if (schedule.interpolation == Interpolation::kLinear
+      && idx + 1 < schedule.time.size()) {
+    double slope = (schedule.value[idx+1] - value)
+                   / (schedule.time[idx+1] - schedule.time[idx]);
+    return n * value + slope * (0.5 * n * (n - 1.));
+  }
+  return n * value;
+}
+
+// The window tables of a schedule with numerical values, built on the first
+// call.
+template <typename T>
+const WindowTables<T>& GetWindowTables(const Schedule<T>& schedule) {
+  if (schedule.window_tables) {
+    return *schedule.window_tables;
+  }
+
+  WindowTables<T>* tables = new WindowTables<T>();
+  schedule.window_tables.reset(tables);
+  const std::vector<T>& value = schedule.value;
+  const std::vector<int>& time = schedule.time;
+  std::size_t n = value.size();
+  if constexpr (std::is_arithmetic<T>::value) {
+    if (n > 0) {
+      tables->prefix_sum.resize(n);
+      tables->prefix_sum[0] = 0;
+      for (std::size_t i = 1; i < n; ++i) {
+        tables->prefix_sum[i] = tables->prefix_sum[i-1]
+                                + SegmentSum(schedule, i - 1,
+                                             time[i] - time[i-1]);
+      }
+    }
+  }
+
+  for (std::size_t len = 2; len <= n; len *= 2) {
+    const std::vector<T>& prev_min = len == 2 ? value
+                                              : tables->range_min.back();
+    const std::vector<T>& prev_max = len == 2 ? value
+                                              : tables->range_max.back();
+    std::vector<T> next_min(n - len + 1);
+    std::vector<T> next_max(n - len + 1);
+    for (std::size_t i = 0; i + len <= n; ++i) {
+      next_min[i] = std::min(prev_min[i], prev_min[i + len/2]);
+      next_max[i] = std::max(prev_max[i], prev_max[i + len/2]);
+    }
+    tables->range_min.push_back(std::move(next_min));
+    tables->range_max.push_back(std::move(next_max));
+  }
+  return *tables;
+}
+
+// Run-length compress a dense schedule with one value per timestep (method 2
+// of `FlexibleInput`) in place into the values at the change points and set
+// `time` to the change points, such that memory and lookups scale with the
+// number of changes instead of the duration. Step interpolation of the result
+// yields the original values.
+template <typename T>
+void CompressRuns(std::vector<T>* value, std::vector<int>* time) {
+  time->clear();
+  std::size_t n = 0;
+  for (std::size_t i = 0; i < value->size(); ++i) {
+    if (i == 0 || !((*value)[i] == (*value)[n-1])) {
+      (*value)[n++] = (*value)[i];
+      time->push_back(i);
+    }
+  }
+  value->resize(n);
+  value->shrink_to_fit();
+}
+
+// Hash function used to intern schedules. Specialise it if `std::hash` is not
+// available for your value type.
+template <typename T>
+struct ScheduleValueHash {
+  std::size_t operator()(const T& value) const {
+    return std::hash<T>()(value);
+  }
+};
+
+// The ScheduleStore interns schedules by content such that all agents using
+// the same schedule (typically clones of one prototype) share one copy of it.
+// Schedules are reference-counted and remove their own entry from the store
+// once the last `FlexibleInput` using them is gone.
+template <typename T>
+class ScheduleStore {
+ public:
+  typedef std::shared_ptr<const Schedule<T> > Ptr;
+
+  // Return the stored schedule with the given content, creating it if it does
+  // not exist yet.
+  static Ptr Intern(std::vector<T> value, std::vector<int> time,
+                    Interpolation interpolation = Interpolation::kStep);
+
+  // Number of distinct schedules currently in use.
+  static std::size_t size();
+
+ private:
+  typedef std::unordered_multimap<std::size_t,
+                                  std::weak_ptr<const Schedule<T> > > Registry;
+
+  // Deletes a schedule and erases its entry from the registry.
+  struct Deleter {
+    std::size_t key;
+    void operator()(const Schedule<T>* schedule) const;
+  };
+
+  static std::size_t Hash_(const std::vector<T>& value,
+                           const std::vector<int>& time,
+                           Interpolation interpolation);
+  static Registry& Registry_();
+};
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+typename ScheduleStore<T>::Ptr ScheduleStore<T>::Intern(
+    std::vector<T> value, std::vector<int> time,
+    Interpolation interpolation) {
+  Registry& registry = Registry_();
+  std::size_t key = Hash_(value, time, interpolation);
+
+  typedef typename Registry::iterator Iterator;
+  std::pair<Iterator, Iterator> range = registry.equal_range(key);
+  for (Iterator it = range.first; it != range.second; ++it) {
+    Ptr schedule = it->second.lock();
+    if (schedule && schedule->interpolation == interpolation
+        && schedule->time == time && schedule->value == value) {
+      return schedule;
+    }
+  }
+
+  Schedule<T>* schedule = new Schedule<T>();
+  schedule->value = std::move(value);
+  schedule->time = std::move(time);
+  schedule->interpolation = interpolation;
+  Ptr ptr(schedule, Deleter{key});
+  registry.insert(std::make_pair(key, std::weak_ptr<const Schedule<T> >(ptr)));
+  return ptr;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+std::size_t ScheduleStore<T>::size() {
+  // Expired entries erase themselves, see `Deleter`.
+  return Registry_().size();
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+void ScheduleStore<T>::Deleter::operator()(const Schedule<T>* schedule) const {
+  // The weak pointer of `schedule` has already expired, hence it is found
+  // among the schedules with the same hash by that.
+  Registry& registry = Registry_();
+  typedef typename Registry::iterator Iterator;
+  std::pair<Iterator, Iterator> range = registry.equal_range(key);
+  for (Iterator it = range.first; it != range.second; ++it) {
+    if (it->second.expired()) {
+      registry.erase(it);
+      break;
+    }
+  }
+  delete schedule;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+std::size_t ScheduleStore<T>::Hash_(const std::vector<T>& value,
+                                    const std::vector<int>& time,
+                                    Interpolation interpolation) {
+  // Combine the hashes as done in boost::hash_combine.
+  std::size_t seed = value.size() + static_cast<std::size_t>(interpolation);
+  ScheduleValueHash<T> value_hash;
+  for (int i = 0; i < value.size(); ++i) {
+    seed ^= value_hash(value[i]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  }
+  std::hash<int> time_hash;
+  for (int i = 0; i < time.size(); ++i) {
+    seed ^= time_hash(time[i]) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+  }
+  return seed;
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+template <class T>
+typename ScheduleStore<T>::Registry& ScheduleStore<T>::Registry_() {
+  static Registry registry;
+  return registry;
+}
+
+}  // namespace flexicamore
+
+#endif  // FLEXICAMORE_SRC_SCHEDULE_STORE_H_
@@ -0,0 +1,233 @@
+#include "separative_work.h"
+
+#include <cfloat>  // DBL_MIN, DBL_MAX
+#include <cmath>
+#include <sstream>
+
+#include "error.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FLEXICAMORE_SWU_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace flexicamore {
+
+namespace {
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CheckAssay(double assay, const char* name) {
+  if (!(assay > 0 && assay < 1)) {
+    std::stringstream ss;
+    ss << "Invalid " << name << " assay '" << assay << "' for the separative "
+       << "work, it must lie in (0, 1).\n";
+    throw cyclus::ValueError(ss.str());
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+inline double ValueFunction(double assay) {
+  return (1 - 2 * assay) * std::log(1 / assay - 1);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void ScalarKernel(double feed_assay, double tails_assay, std::size_t begin,
+                  std::size_t end, const double* product_assay,
+                  const double* product_qty, double* swu, double* feed) {
+  double v_feed = ValueFunction(feed_assay);
+  double v_tails = ValueFunction(tails_assay);
+  for (std::size_t i = begin; i < end; ++i) {
+    double x = product_assay[i];
+    double q = product_qty[i];
+    // Same order of operations as the toolkit, such that the results agree
+    // also where the terms of the SWU cancel.
+    double feed_qty = q * ((x - tails_assay) / (feed_assay - tails_assay));
+    double tails_qty = q * ((x - feed_assay) / (feed_assay - tails_assay));
+    feed[i] = feed_qty;
+    swu[i] = q * ValueFunction(x) + tails_qty * v_tails - feed_qty * v_feed;
+  }
+}
+
+#ifdef FLEXICAMORE_SWU_AVX2
+// Largest ratio of the product term of the SWU to the SWU for which the
+// vectorised kernel is used. `Log4` is accurate to about 2 ulp of the product
+// term, hence this bounds the relative error of the SWU by about 5e-13.
+const double kMaxCancellation = 1024;
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+// Natural logarithm of four positive, normal doubles, following the
+// algorithm of fdlibm's `__ieee754_log` (error below 1 ulp): y = 2^k (1 + f)
+// with 1 + f in [sqrt(2)/2, sqrt(2)), and ln(1 + f) = 2s + s R(s^2) with
+// s = f / (2 + f).
+__attribute__((target("avx2")))
+inline __m256d Log4(__m256d y) {
+  const __m256d ln2_hi = _mm256_set1_pd(6.93147180369123816490e-01);
+  const __m256d ln2_lo = _mm256_set1_pd(1.90821492927058770002e-10);
+  const __m256d lg1 = _mm256_set1_pd(6.666666666666735130e-01);
+  const __m256d lg2 = _mm256_set1_pd(3.999999999940941908e-01);
+  const __m256d lg3 = _mm256_set1_pd(2.857142874366239149e-01);
+  const __m256d lg4 = _mm256_set1_pd(2.222219843214978396e-01);
+  const __m256d lg5 = _mm256_set1_pd(1.818357216161805012e-01);
+  const __m256d lg6 = _mm256_set1_pd(1.531383769920937332e-01);
+  const __m256d lg7 = _mm256_set1_pd(1.479819860511658591e-01);
+  const __m256d one = _mm256_set1_pd(1.);
+  const __m256d half = _mm256_set1_pd(0.5);
+
+  // Split into the biased exponent and the mantissa m in [1, 2). The
+  // exponent (< 2^11) is converted to a double by placing it in the mantissa
+  // of 2^52.
+  __m256i bits = _mm256_castpd_si256(y);
+  __m256i exponent = _mm256_srli_epi64(bits, 52);
+  const __m256i two_52 = _mm256_set1_epi64x(0x4330000000000000LL);
+  __m256d k = _mm256_sub_pd(
+      _mm256_castsi256_pd(_mm256_or_si256(exponent, two_52)),
+      _mm256_set1_pd(4503599627370496. + 1023.));
+  __m256i mantissa = _mm256_or_si256(
+      _mm256_and_si256(bits, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+      _mm256_set1_epi64x(0x3FF0000000000000LL));
+  __m256d m = _mm256_castsi256_pd(mantissa);
+
+  // Move m to [sqrt(2)/2, sqrt(2)).
+  __m256d large = _mm256_cmp_pd(m, _mm256_set1_pd(1.41421356237309504880),
+                                _CMP_GT_OQ);
+  m = _mm256_blendv_pd(m, _mm256_mul_pd(m, half), large);
+  k = _mm256_add_pd(k, _mm256_and_pd(large, one));
+
+  __m256d f = _mm256_sub_pd(m, one);
+  __m256d s = _mm256_div_pd(f, _mm256_add_pd(_mm256_set1_pd(2.), f));
+  __m256d z = _mm256_mul_pd(s, s);
+  __m256d w = _mm256_mul_pd(z, z);
+  __m256d t1 = _mm256_mul_pd(w, _mm256_add_pd(lg2, _mm256_mul_pd(w,
+      _mm256_add_pd(lg4, _mm256_mul_pd(w, lg6)))));
+  __m256d t2 = _mm256_mul_pd(z, _mm256_add_pd(lg1, _mm256_mul_pd(w,
+      _mm256_add_pd(lg3, _mm256_mul_pd(w, _mm256_add_pd(lg5,
+          _mm256_mul_pd(w, lg7)))))));
+  __m256d r = _mm256_add_pd(t2, t1);
+  __m256d hfsq = _mm256_mul_pd(half, _mm256_mul_pd(f, f));
+
+  // k ln2_hi - ((hfsq - (s (hfsq + R) + k ln2_lo)) - f)
+  __m256d inner = _mm256_add_pd(_mm256_mul_pd(s, _mm256_add_pd(hfsq, r)),
+                                _mm256_mul_pd(k, ln2_lo));
+  return _mm256_sub_pd(_mm256_mul_pd(k, ln2_hi),
+                       _mm256_sub_pd(_mm256_sub_pd(hfsq, inner), f));
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+__attribute__((target("avx2")))
+void Avx2Kernel(double feed_assay, double tails_assay, std::size_t n,
+                const double* product_assay, const double* product_qty,
+                double* swu, double* feed) {
+  const __m256d one = _mm256_set1_pd(1.);
+  const __m256d two = _mm256_set1_pd(2.);
+  const __m256d x_f = _mm256_set1_pd(feed_assay);
+  const __m256d x_t = _mm256_set1_pd(tails_assay);
+  const __m256d delta = _mm256_set1_pd(feed_assay - tails_assay);
+  const __m256d v_feed = _mm256_set1_pd(ValueFunction(feed_assay));
+  const __m256d v_tails = _mm256_set1_pd(ValueFunction(tails_assay));
+
+  const __m256d normal_min = _mm256_set1_pd(DBL_MIN);
+  const __m256d normal_max = _mm256_set1_pd(DBL_MAX);
+  const __m256d abs_mask = _mm256_castsi256_pd(
+      _mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFLL));
+  const __m256d max_cancellation = _mm256_set1_pd(kMaxCancellation);
+
+  std::size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256d x = _mm256_loadu_pd(product_assay + i);
+    __m256d q = _mm256_loadu_pd(product_qty + i);
+    __m256d odds = _mm256_sub_pd(_mm256_div_pd(one, x), one);
+    // `Log4` only handles normal numbers; assays within about 1e-16 of 0 or
+    // 1 are left to the scalar kernel.
+    __m256d normal = _mm256_and_pd(
+        _mm256_cmp_pd(odds, normal_min, _CMP_GE_OQ),
+        _mm256_cmp_pd(odds, normal_max, _CMP_LE_OQ));
+    if (_mm256_movemask_pd(normal) != 0xF) {
+      ScalarKernel(feed_assay, tails_assay, i, i + 4, product_assay,
+                   product_qty, swu, feed);
+      continue;
+    }
+    __m256d feed_qty = _mm256_mul_pd(
+        q, _mm256_div_pd(_mm256_sub_pd(x, x_t), delta));
+    __m256d tails_qty = _mm256_mul_pd(
+        q, _mm256_div_pd(_mm256_sub_pd(x, x_f), delta));
+    // V(x) = (1 - 2x) ln(1/x - 1)
+    __m256d v = _mm256_mul_pd(_mm256_sub_pd(one, _mm256_mul_pd(two, x)),
+                              Log4(odds));
+    __m256d product_term = _mm256_mul_pd(q, v);
+    __m256d result = _mm256_sub_pd(
+        _mm256_add_pd(product_term, _mm256_mul_pd(tails_qty, v_tails)),
+        _mm256_mul_pd(feed_qty, v_feed));
+    // Only the product term differs from the scalar kernel. For product
+    // assays close to the feed assay the terms cancel and amplify its error.
+    __m256d cancelled = _mm256_cmp_pd(
+        _mm256_and_pd(product_term, abs_mask),
+        _mm256_mul_pd(_mm256_and_pd(result, abs_mask), max_cancellation),
+        _CMP_GT_OQ);
+    if (_mm256_movemask_pd(cancelled) != 0) {
+      ScalarKernel(feed_assay, tails_assay, i, i + 4, product_assay,
+                   product_qty, swu, feed);
+      continue;
+    }
+    _mm256_storeu_pd(feed + i, feed_qty);
+    _mm256_storeu_pd(swu + i, result);
+  }
+  ScalarKernel(feed_assay, tails_assay, i, n, product_assay, product_qty,
+               swu, feed);
+}
+#endif  // FLEXICAMORE_SWU_AVX2
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void CheckAssays(double feed_assay, double tails_assay, std::size_t n,
+                 const double* product_assay) {
+  CheckAssay(feed_assay, "feed");
+  CheckAssay(tails_assay, "tails");
+  if (!(feed_assay > tails_assay)) {
+    std::stringstream ss;
+    ss << "Invalid assays for the separative work: the feed assay '"
+       << feed_assay << "' must exceed the tails assay '" << tails_assay
+       << "'.\n";
+    throw cyclus::ValueError(ss.str());
+  }
+  for (std::size_t i = 0; i < n; ++i) {
+    CheckAssay(product_assay[i], "product");
+  }
+}
+
+}  // namespace
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SwuFeedBatch(double feed_assay, double tails_assay, std::size_t n,
+                  const double* product_assay, const double* product_qty,
+                  double* swu, double* feed) {
+  CheckAssays(feed_assay, tails_assay, n, product_assay);
+#ifdef FLEXICAMORE_SWU_AVX2
+  if (SwuFeedBatchVectorised()) {
+    Avx2Kernel(feed_assay, tails_assay, n, product_assay, product_qty, swu,
+               feed);
+    return;
+  }
+#endif
+  ScalarKernel(feed_assay, tails_assay, 0, n, product_assay, product_qty, swu,
+               feed);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void SwuFeedBatchScalar(double feed_assay, double tails_assay, std::size_t n,
+                        const double* product_assay, const double* product_qty,
+                        double* swu, double* feed) {
+  CheckAssays(feed_assay, tails_assay, n, product_assay);
+  ScalarKernel(feed_assay, tails_assay, 0, n, product_assay, product_qty, swu,
+               feed);
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+bool SwuFeedBatchVectorised() {
+#ifdef FLEXICAMORE_SWU_AVX2
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+}  // namespace flexicamore
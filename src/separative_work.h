@@ -0,0 +1,39 @@
+#ifndef FLEXICAMORE_SRC_SEPARATIVE_WORK_H_
+#define FLEXICAMORE_SRC_SEPARATIVE_WORK_H_
+
+#include <cstddef>  // std::size_t
+
+namespace flexicamore {
+
+// Batch computation of the separative work and the feed required to produce
+// `product_qty[i]` of product with assay `product_assay[i]` (i < n) from one
+// feed and tails assay. The results equal `cyclus::toolkit::SwuRequired` and
+// `cyclus::toolkit::FeedQty` of the single products.
+//
+// The cost is dominated by the logarithm of the value function
+// V(x) = (1 - 2x) ln((1 - x) / x), which is evaluated for four products at
+// once with AVX2 if the CPU supports it. The instruction set is detected at
+// runtime, such that the library runs on any x86-64 (or other) CPU; the
+// scalar kernel is used otherwise. Both kernels agree with the toolkit to a
+// relative error below 1e-12; products whose SWU nearly cancels (product
+// assays close to the feed assay) are always computed by the scalar kernel.
+//
+// All assays must lie in (0, 1) and the feed assay must exceed the tails
+// assay, else a `cyclus::ValueError` is thrown. `swu` and `feed` must hold
+// `n` values each.
+void SwuFeedBatch(double feed_assay, double tails_assay, std::size_t n,
+                  const double* product_assay, const double* product_qty,
+                  double* swu, double* feed);
+
+// Same as `SwuFeedBatch` but always using the scalar kernel, e.g., to check
+// the vectorised one.
+void SwuFeedBatchScalar(double feed_assay, double tails_assay, std::size_t n,
+                        const double* product_assay, const double* product_qty,
+                        double* swu, double* feed);
+
+// True if `SwuFeedBatch` uses the vectorised kernel on this CPU.
+bool SwuFeedBatchVectorised();
+
+}  // namespace flexicamore
+
+#endif  // FLEXICAMORE_SRC_SEPARATIVE_WORK_H_
@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <cmath>  // std::fabs, std::pow
+#include <cstddef>  // std::size_t
+#include <random>
+#include <vector>
+
+#include "cyclus.h"
+#include "error.h"
+
+#include "separative_work.h"
+
+namespace flexicamore {
+
+namespace {
+
+// Relative error, or the absolute error if `expected` vanishes.
+double RelativeError(double expected, double actual) {
+  double error = std::fabs(actual - expected);
+  return expected != 0 ? error / std::fabs(expected) : error;
+}
+
+}  // namespace
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(SeparativeWorkTest, MatchesToolkit) {
+  const double feed_assay = 0.0072;
+  const double tails_assay = 0.002;
+  // Odd size to also cover the remainder handled by the scalar kernel.
+  const std::size_t n = 4099;
+
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> assay_dist(0.0072, 0.95);
+  std::uniform_real_distribution<double> qty_dist(0., 1e4);
+  std::vector<double> assays(n);
+  std::vector<double> qtys(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    assays[i] = assay_dist(rng);
+    qtys[i] = qty_dist(rng);
+  }
+  // Extreme but valid assays.
+  assays[0] = 1 - 1e-15;
+  assays[1] = 0.5;
+  assays[2] = 1e-3;
+  // Assays close to the feed assay, where the terms of the SWU cancel.
+  assays[3] = feed_assay;
+  std::uniform_real_distribution<double> exponent_dist(-12., -1.);
+  for (std::size_t i = 4; i < 2052; ++i) {
+    double offset = std::pow(10., exponent_dist(rng));
+    assays[i] = feed_assay * (i % 2 == 0 ? 1 + offset : 1 - offset);
+  }
+
+  std::vector<double> swu(n);
+  std::vector<double> feed(n);
+  std::vector<double> swu_scalar(n);
+  std::vector<double> feed_scalar(n);
+  SwuFeedBatch(feed_assay, tails_assay, n, &assays[0], &qtys[0], &swu[0],
+               &feed[0]);
+  SwuFeedBatchScalar(feed_assay, tails_assay, n, &assays[0], &qtys[0],
+                     &swu_scalar[0], &feed_scalar[0]);
+
+  for (std::size_t i = 0; i < n; ++i) {
+    cyclus::toolkit::Assays triple(feed_assay, assays[i], tails_assay);
+    double exp_swu = cyclus::toolkit::SwuRequired(qtys[i], triple);
+    double exp_feed = cyclus::toolkit::FeedQty(qtys[i], triple);
+    EXPECT_LT(RelativeError(exp_swu, swu[i]), 1e-12) << i;
+    EXPECT_LT(RelativeError(exp_feed, feed[i]), 1e-12) << i;
+    EXPECT_LT(RelativeError(exp_swu, swu_scalar[i]), 1e-12) << i;
+    EXPECT_LT(RelativeError(exp_feed, feed_scalar[i]), 1e-12) << i;
+  }
+}
+
+// - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+TEST(SeparativeWorkTest, InvalidAssays) {
+  double assay = 0.05;
+  double qty = 1.;
+  double swu;
+  double feed;
+  EXPECT_THROW(SwuFeedBatch(0., 0.002, 1, &assay, &qty, &swu, &feed),
+               cyclus::ValueError);
+  EXPECT_THROW(SwuFeedBatch(0.0072, 1., 1, &assay, &qty, &swu, &feed),
+               cyclus::ValueError);
+  EXPECT_THROW(SwuFeedBatch(0.002, 0.0072, 1, &assay, &qty, &swu, &feed),
+               cyclus::ValueError);
+  assay = 1.;
+  EXPECT_THROW(SwuFeedBatch(0.0072, 0.002, 1, &assay, &qty, &swu, &feed),
+               cyclus::ValueError);
+  // Empty batches are fine.
+  EXPECT_NO_THROW(SwuFeedBatch(0.0072, 0.002, 0, NULL, NULL, NULL, NULL));
+}
+
+}  // namespace flexicamore
@@ -13,6 +13,12 @@ FlexibleSink::FlexibleSink(cyclus::Context* ctx)
       current_throughput(1e299),
       throughput_vals(std::vector<double>({})),
       throughput_times(std::vector<int>({})),
+      throughput_interp("step"),
+      throughput_file(""),
+      throughput_expr(""),
+      schedule_seed(0),
+      ensemble_member(-1),
+      throughput_idx(0),
       latitude(0.0),
       longitude(0.0),
       coordinates(latitude, longitude) {
@@ -43,13 +49,25 @@ FlexibleSink::~FlexibleSink() {}
 void FlexibleSink::EnterNotify() {
   cyclus::Facility::EnterNotify();
 
-  if (throughput_times[0]==-1) {
+  if (!throughput_expr.empty()) {
+    if (ensemble_member < 0) {
+      ensemble_member = ScheduleExpression::EnsembleMember();
+    }
+    flexible_throughput = FlexibleInput<double>::FromExpression(
+        this, throughput_expr, schedule_seed, ensemble_member);
+  } else if (!throughput_file.empty()) {
+    flexible_throughput = FlexibleInput<double>::FromFile(
+        this, throughput_file, ParseInterpolation(throughput_interp));
+  } else if (throughput_times[0] == -1) {
     flexible_throughput = FlexibleInput<double>(this, throughput_vals);
   } else {
-    flexible_throughput = FlexibleInput<double>(this, throughput_vals,
-                                                throughput_times);
+    flexible_throughput = FlexibleInput<double>(
+        this, throughput_vals, throughput_times,
+        ParseInterpolation(throughput_interp));
   }
-  current_throughput = throughput_vals[0];
+  flexible_throughput.set_cursor(throughput_idx);
+  throughput_slot_ = ScheduleSlot<double>(this, flexible_throughput);
+  current_throughput = flexible_throughput.ValueAt(0);
 
   if (in_commod_prefs.size() == 0) {
     for (int i = 0; i < in_commods.size(); ++i) {
@@ -61,6 +79,19 @@ void FlexibleSink::EnterNotify() {
        << " values, expected " << in_commods.size();
     throw cyclus::ValueError(ss.str());
   }
+  if (!in_commod_prefs_vals.empty()) {
+    if (in_commod_prefs_times.size() == 1
+        && in_commod_prefs_times[0] == -1) {
+      flexible_in_prefs = FlexibleVectorInput<double>(
+          this, in_commods.size(), in_commod_prefs_vals);
+    } else {
+      flexible_in_prefs = FlexibleVectorInput<double>(
+          this, in_commods.size(), in_commod_prefs_vals,
+          in_commod_prefs_times);
+    }
+    flexible_in_prefs.Update(this);
+    in_commod_prefs = flexible_in_prefs.values();
+  }
   RecordPosition();
 }
 
@@ -182,17 +213,13 @@ void FlexibleSink::Tick() {
   using std::string;
   using std::vector;
 
-  // For an unknown reason, 'UpdateValue' has to be called with a copy of
-  // the 'this' pointer. When directly using 'this', the address passed to
-  // the function is increased by 8 bits resulting later on in a
-  // segmentation fault.
-  // TODO The problem described above has not been checked in FlexibleSink
-  // but it was the case in MIsoEnrichment. Maybe check if this has changed
-  // (for whatever reason) here in FlexibleSink?
-  cyclus::Agent* copy_ptr;
-  cyclus::Agent* source_ptr = this;
-  std::memcpy((void*) &copy_ptr, (void*) &source_ptr, sizeof(cyclus::Agent*));
-  current_throughput = flexible_throughput.UpdateValue(copy_ptr);
+  if (throughput_slot_.Update(context()->time())) {
+    current_throughput = throughput_slot_.value();
+  }
+  throughput_idx = throughput_slot_.cursor();
+  if (!flexible_in_prefs.empty() && flexible_in_prefs.Update(this)) {
+    in_commod_prefs = flexible_in_prefs.values();
+  }
 
   // Crucial that current_throughput gets updated before!
   double requestAmt = RequestAmt();
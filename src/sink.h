@@ -9,6 +9,8 @@
 #include "cyclus.h"
 
 #include "flexible_input.h"
+#include "flexible_vector_input.h"
+#include "schedule_registry.h"
 
 namespace flexicamore {
 
@@ -101,6 +103,30 @@ class FlexibleSink
                       "uitype":["oneormore", "range"]}
   std::vector<double> in_commod_prefs;
 
+  #pragma cyclus var { \
+    "default": [], \
+    "tooltip": "Input commodity preferences change times", \
+    "uilabel": "Input commodity preferences change times", \
+    "doc": "times at which the input commodity preferences change, relative " \
+           "to the deployment of the facility. The first time must be 0. Set" \
+           " it to [-1] to give the preferences of all timesteps in " \
+           "`in_commod_prefs_vals` instead (method 2, see README)." \
+  }
+  std::vector<int> in_commod_prefs_times;
+
+  #pragma cyclus var { \
+    "default": [], \
+    "tooltip": "time-dependent input commodity preferences", \
+    "uilabel": "Time-dependent input commodity preferences", \
+    "doc": "time-dependent input commodity preferences: the preferences of " \
+           "all commodities (in the same order as in 'in_commods') at the " \
+           "first change time, followed by the ones at the second change " \
+           "time, etc. If set, `in_commod_prefs` is only used to check the " \
+           "number of commodities and may be omitted." \
+  }
+  std::vector<double> in_commod_prefs_vals;
+  FlexibleVectorInput<double> flexible_in_prefs;
+
   #pragma cyclus var {"default": "", \
                       "tooltip": "requested composition", \
                       "doc": "name of recipe to use for material requests, " \
@@ -143,7 +169,78 @@ class FlexibleSink
            "that can be supplied at that time step.", \
   }
   std::vector<double> throughput_vals;
+
+  #pragma cyclus var { \
+    "default": "step", \
+    "tooltip": "Throughput interpolation between change times", \
+    "uilabel": "Throughput interpolation", \
+    "doc": "how the throughput is determined between the times listed in " \
+           "`throughput_times`: 'step' keeps the value until the next change" \
+           " time, 'linear' interpolates linearly between the change times " \
+           "such that ramps can be defined by their end points only. Ignored" \
+           " if method 2 (see README) is used." \
+  }
+  std::string throughput_interp;
+
+  #pragma cyclus var { \
+    "default": "", \
+    "tooltip": "Throughput schedule file", \
+    "uilabel": "Throughput schedule file", \
+    "doc": "file containing the throughput schedule. If set, " \
+           "`throughput_vals` and `throughput_times` are ignored. Files " \
+           "ending in '.csv' contain either one value per timestep or " \
+           "'time,value' pairs per line, all other files contain the raw " \
+           "values (64 bit floats, native byte order) of all timesteps and " \
+           "are memory-mapped instead of being read." \
+  }
+  std::string throughput_file;
+
+  #pragma cyclus var { \
+    "default": "", \
+    "tooltip": "Throughput formula", \
+    "uilabel": "Throughput formula", \
+    "doc": "formula of the relative time `t` (timesteps since the deployment" \
+           " of the facility) defining the throughput, e.g., `100 * 1.02^t` " \
+           "or `if(t % 12 == 11, 0, 100)`. If set, it replaces all other " \
+           "`throughput_*` schedule variables. See `schedule_expression.h` " \
+           "for the syntax." \
+  }
+  std::string throughput_expr;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "tooltip": "seed of random schedule functions", \
+    "uilabel": "Schedule seed", \
+    "doc": "seed of the random functions (e.g., `normal(mean, stddev)`) " \
+           "used in `throughput_expr`. Together with the agent id and the " \
+           "`ensemble_member` it determines the random values, i.e., " \
+           "runs with the same seed and ensemble member are reproducible." \
+  }
+  int schedule_seed;
+
+  #pragma cyclus var { \
+    "default": -1, \
+    "tooltip": "ensemble member of random schedule functions", \
+    "uilabel": "Ensemble member", \
+    "doc": "member of an ensemble run, combined with `schedule_seed` for " \
+           "the random functions used in `throughput_expr`. " \
+           "If negative, it is taken from the environment variable " \
+           "FLEXICAMORE_ENSEMBLE_MEMBER (0 if not set) when the agent " \
+           "enters the simulation and stored, such that the member used is " \
+           "recorded with the agent state." \
+  }
+  int ensemble_member;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "internal": True, \
+    "doc": "position in the throughput schedule, stored such that restarted " \
+           "simulations continue from there." \
+  }
+  int throughput_idx;
   FlexibleInput<double> flexible_throughput;
+  // Registration of `flexible_throughput` in the simulation's ScheduleRegistry.
+  ScheduleSlot<double> throughput_slot_;
 
   #pragma cyclus var
   double current_throughput;
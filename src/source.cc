@@ -16,6 +16,12 @@ FlexibleSource::FlexibleSource(cyclus::Context* ctx)
       inventory_size(1e299),
       throughput_times(std::vector<int>({-1})),
       throughput_vals(std::vector<double>({1e299})),
+      throughput_interp("step"),
+      throughput_file(""),
+      throughput_expr(""),
+      schedule_seed(0),
+      ensemble_member(-1),
+      throughput_idx(0),
       flexible_throughput(FlexibleInput<double>()),
       current_throughput(0.),
       latitude(0.0),
@@ -63,13 +69,25 @@ void FlexibleSource::EnterNotify() {
 
   cyclus::Facility::EnterNotify();
 
-  if (throughput_times[0]==-1) {
+  if (!throughput_expr.empty()) {
+    if (ensemble_member < 0) {
+      ensemble_member = ScheduleExpression::EnsembleMember();
+    }
+    flexible_throughput = FlexibleInput<double>::FromExpression(
+        this, throughput_expr, schedule_seed, ensemble_member);
+  } else if (!throughput_file.empty()) {
+    flexible_throughput = FlexibleInput<double>::FromFile(
+        this, throughput_file, ParseInterpolation(throughput_interp));
+  } else if (throughput_times[0] == -1) {
     flexible_throughput = FlexibleInput<double>(this, throughput_vals);
   } else {
-    flexible_throughput = FlexibleInput<double>(this, throughput_vals,
-                                                throughput_times);
+    flexible_throughput = FlexibleInput<double>(
+        this, throughput_vals, throughput_times,
+        ParseInterpolation(throughput_interp));
   }
-  current_throughput = throughput_vals[0];
+  flexible_throughput.set_cursor(throughput_idx);
+  throughput_slot_ = ScheduleSlot<double>(this, flexible_throughput);
+  current_throughput = flexible_throughput.ValueAt(0);
   tk::CommodityProducer::SetCapacity(tk::Commodity(out_commod),
                                      current_throughput);
   tk::CommodityProducer::SetCost(tk::Commodity(out_commod), current_throughput);
@@ -83,17 +101,15 @@ void FlexibleSource::EnterNotify() {
 void FlexibleSource::Tick() {
   namespace tk = cyclus::toolkit;
 
-  // For an unknown reason, 'UpdateValue' has to be called with a copy of
-  // the 'this' pointer. When directly using 'this', the address passed to
-  // the function is increased by 8 bits resulting later on in a
-  // segmentation fault.
-  // TODO The problem described above has not been checked in FlexibleSource
-  // but it was the case in MIsoEnrichment. Maybe check if this has changed
-  // (for whatever reason) here in FlexibleSource?
-  cyclus::Agent* copy_ptr;
-  cyclus::Agent* source_ptr = this;
-  std::memcpy((void*) &copy_ptr, (void*) &source_ptr, sizeof(cyclus::Agent*));
-  current_throughput = flexible_throughput.UpdateValue(copy_ptr);
+  bool changed = throughput_slot_.Update(context()->time());
+  throughput_idx = throughput_slot_.cursor();
+
+  // Capacity and cost only need to be updated at the change points of the
+  // throughput schedule.
+  if (!changed) {
+    return;
+  }
+  current_throughput = throughput_slot_.value();
   tk::CommodityProducer::SetCapacity(tk::Commodity(out_commod),
                                      current_throughput);
   tk::CommodityProducer::SetCost(tk::Commodity(out_commod), current_throughput);
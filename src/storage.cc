@@ -7,6 +7,13 @@ FlexibleStorage::FlexibleStorage(cyclus::Context* ctx)
     : cyclus::Facility(ctx),
       max_inv_size_vals(std::vector<double>()),
       max_inv_size_times(std::vector<int>()),
+      max_inv_size_interp("step"),
+      max_inv_size_file(""),
+      max_inv_size_expr(""),
+      schedule_seed(0),
+      ensemble_member(-1),
+      max_inv_size_idx(0),
+      inv_size_lookahead(0),
       latitude(0.0),
       longitude(0.0),
       coordinates(latitude, longitude) {
@@ -49,26 +56,32 @@ void FlexibleStorage::InitFrom(cyclus::QueryableBackend* b) {
 void FlexibleStorage::EnterNotify() {
   cyclus::Facility::EnterNotify();
 
-  if (max_inv_size_times[0] == -1) {
+  if (!max_inv_size_expr.empty()) {
+    if (ensemble_member < 0) {
+      ensemble_member = ScheduleExpression::EnsembleMember();
+    }
+    flexible_inv_size = FlexibleInput<double>::FromExpression(
+        this, max_inv_size_expr, schedule_seed, ensemble_member);
+  } else if (!max_inv_size_file.empty()) {
+    flexible_inv_size = FlexibleInput<double>::FromFile(
+        this, max_inv_size_file, ParseInterpolation(max_inv_size_interp));
+  } else if (max_inv_size_times[0] == -1) {
     flexible_inv_size = FlexibleInput<double>(this, max_inv_size_vals);
   } else {
-    flexible_inv_size = FlexibleInput<double>(this, max_inv_size_vals,
-                                              max_inv_size_times);
+    flexible_inv_size = FlexibleInput<double>(
+        this, max_inv_size_vals, max_inv_size_times,
+        ParseInterpolation(max_inv_size_interp));
   }
-  inventory_tracker.set_capacity(max_inv_size_vals[0]);
+  flexible_inv_size.set_cursor(max_inv_size_idx);
+  inv_size_slot_ = ScheduleSlot<double>(this, flexible_inv_size);
+  inventory_tracker.set_capacity(
+      flexible_inv_size.WindowMin(0, inv_size_lookahead));
 
   // For now, active and dormant policies are omitted.
   buy_policy.Init(
     this, &inventory, std::string("inventory"), &inventory_tracker, throughput
   );
 
-  // dummy comp, use in_recipe if provided
-  cyclus::CompMap v;
-  cyclus::Composition::Ptr comp = cyclus::Composition::CreateFromAtom(v);
-  if (in_recipe != "") {
-    comp = context()->GetRecipe(in_recipe);
-  }
-
   if (in_commod_prefs.size() == 0) {
     for (int i = 0; i < in_commods.size(); ++i) {
       in_commod_prefs.push_back(cyclus::kDefaultPref);
@@ -79,10 +92,20 @@ void FlexibleStorage::EnterNotify() {
        << " values, expected " << in_commods.size();
     throw cyclus::ValueError(ss.str());
   }
-
-  for (int i = 0; i != in_commods.size(); ++i) {
-    buy_policy.Set(in_commods[i], comp, in_commod_prefs[i]);
+  if (!in_commod_prefs_vals.empty()) {
+    if (in_commod_prefs_times.size() == 1
+        && in_commod_prefs_times[0] == -1) {
+      flexible_in_prefs = FlexibleVectorInput<double>(
+          this, in_commods.size(), in_commod_prefs_vals);
+    } else {
+      flexible_in_prefs = FlexibleVectorInput<double>(
+          this, in_commods.size(), in_commod_prefs_vals,
+          in_commod_prefs_times);
+    }
+    flexible_in_prefs.Update(this);
+    in_commod_prefs = flexible_in_prefs.values();
   }
+  SetBuyPrefs_();
   buy_policy.Start();
 
   if (out_commods.size() == 1) {
@@ -144,17 +167,6 @@ void FlexibleStorage::AddMat_(cyclus::Material::Ptr mat) {
 void FlexibleStorage::Tick() {
   // Set current inv size and available capacity for Buy Policy
   //
-  // For an unknown reason, 'UpdateValue' has to be called with a copy of
-  // the 'this' pointer. When directly using 'this', the address passed to
-  // the function is increased by 8 bits resulting later on in a
-  // segmentation fault.
-  // TODO The problem described above has not been checked in FlexibleStorage
-  // but it was the case in MIsoEnrichment. Maybe check if this has changed
-  // (for whatever reason) here in FlexibleEnrichment?
-  cyclus::Agent* copy_ptr;
-  cyclus::Agent* source_ptr = this;
-  std::memcpy((void*) &copy_ptr, (void*) &source_ptr, sizeof(cyclus::Agent*));
-
   // Set the current capacity.
   // Here, a hack is needed: TotalInvTracker does not allow to set a capacity
   // smaller than the current quantity.
@@ -162,10 +174,26 @@ void FlexibleStorage::Tick() {
   // If the current capacity is smaller than the current quantity, set current
   // capacity to current quantity to ensure no new material gets requested.
   // Then, try to set it to the desired capacity in the following time step(s).
-  double new_capacity = std::max(
-    flexible_inv_size.UpdateValue(copy_ptr),
-    inventory_tracker.quantity());
-  inventory_tracker.set_capacity(new_capacity);
+  // Apart from that, the capacity only changes at the change points of the
+  // schedule. With a lookahead, the capacity is the smallest one of the
+  // upcoming timesteps instead.
+  bool changed = inv_size_slot_.Update(context()->time());
+  max_inv_size_idx = inv_size_slot_.cursor();
+  double inv_size = inv_size_slot_.value();
+  if (inv_size_lookahead > 0) {
+    inv_size = flexible_inv_size.WindowMin(context()->time() - enter_time(),
+                                           inv_size_lookahead);
+  }
+  if (changed || inventory_tracker.capacity() != inv_size) {
+    double new_capacity = std::max(inv_size, inventory_tracker.quantity());
+    inventory_tracker.set_capacity(new_capacity);
+  }
+
+  // The preferences only change at their change points.
+  if (!flexible_in_prefs.empty() && flexible_in_prefs.Update(this)) {
+    in_commod_prefs = flexible_in_prefs.values();
+    SetBuyPrefs_();
+  }
 
   LOG(cyclus::LEV_INFO4, "FlxSto")
       << prototype() << "-" << id() << " has capacity for "
@@ -257,6 +285,20 @@ void FlexibleStorage::ReadyMatl_(int time) {
   ready.Push(processing.PopN(to_ready));
 }
 
+//- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
+void FlexibleStorage::SetBuyPrefs_() {
+  // dummy comp, use in_recipe if provided
+  cyclus::CompMap v;
+  cyclus::Composition::Ptr comp = cyclus::Composition::CreateFromAtom(v);
+  if (in_recipe != "") {
+    comp = context()->GetRecipe(in_recipe);
+  }
+
+  for (int i = 0; i != in_commods.size(); ++i) {
+    buy_policy.Set(in_commods[i], comp, in_commod_prefs[i]);
+  }
+}
+
 //- - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 void FlexibleStorage::RecordPosition() {
   std::string specification = this->spec();
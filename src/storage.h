@@ -9,6 +9,8 @@
 #include "cyclus.h"
 
 #include "flexible_input.h"
+#include "flexible_vector_input.h"
+#include "schedule_registry.h"
 
 namespace flexicamore {
 /// @class FlexibleStorage
@@ -71,6 +73,8 @@ class FlexibleStorage
   void ProcessMat_(double cap);
   /// Move ready resources from processing to ready at a certain time.
   void ReadyMatl_(int time);
+  /// Pass the current input commodity preferences to the buy policy.
+  void SetBuyPrefs_();
 
   /// Current maximum amount that can be added to the facility.
   inline double current_capacity() {
@@ -99,6 +103,30 @@ class FlexibleStorage
                       "uitype": ["oneormore", "range"]}
   std::vector<double> in_commod_prefs;
 
+  #pragma cyclus var { \
+    "default": [], \
+    "tooltip": "Input commodity preferences change times", \
+    "uilabel": "Input commodity preferences change times", \
+    "doc": "times at which the input commodity preferences change, relative " \
+           "to the deployment of the facility. The first time must be 0. Set" \
+           " it to [-1] to give the preferences of all timesteps in " \
+           "`in_commod_prefs_vals` instead (method 2, see README)." \
+  }
+  std::vector<int> in_commod_prefs_times;
+
+  #pragma cyclus var { \
+    "default": [], \
+    "tooltip": "time-dependent input commodity preferences", \
+    "uilabel": "Time-dependent input commodity preferences", \
+    "doc": "time-dependent input commodity preferences: the preferences of " \
+           "all commodities (in the same order as in 'in_commods') at the " \
+           "first change time, followed by the ones at the second change " \
+           "time, etc. If set, `in_commod_prefs` is only used to check the " \
+           "number of commodities and may be omitted." \
+  }
+  std::vector<double> in_commod_prefs_vals;
+  FlexibleVectorInput<double> flexible_in_prefs;
+
   #pragma cyclus var {"tooltip": "output commodity",\
                       "doc": "commodity produced by this facility. Multiple " \
                              "commodity tracking is currently not supported, " \
@@ -159,7 +187,90 @@ class FlexibleStorage
            "deployment of the facility, not from the start of the simulation." \
   }
   std::vector<int> max_inv_size_times;
+
+  #pragma cyclus var { \
+    "default": "step", \
+    "tooltip": "Maximum inventory size interpolation between change times", \
+    "uilabel": "Maximum inventory size interpolation", \
+    "doc": "how the maximum inventory size is determined between the times " \
+           "listed in `max_inv_size_times`: 'step' keeps the value until the" \
+           " next change time, 'linear' interpolates linearly between the " \
+           "change times such that ramps can be defined by their end points " \
+           "only. Ignored if method 2 (see README) is used." \
+  }
+  std::string max_inv_size_interp;
+
+  #pragma cyclus var { \
+    "default": "", \
+    "tooltip": "Maximum inventory size schedule file", \
+    "uilabel": "Maximum inventory size schedule file", \
+    "doc": "file containing the maximum inventory size schedule. If set, " \
+           "`max_inv_size_vals` and `max_inv_size_times` are ignored. Files " \
+           "ending in '.csv' contain either one value per timestep or " \
+           "'time,value' pairs per line, all other files contain the raw " \
+           "values (64 bit floats, native byte order) of all timesteps and " \
+           "are memory-mapped instead of being read." \
+  }
+  std::string max_inv_size_file;
+
+  #pragma cyclus var { \
+    "default": "", \
+    "tooltip": "Maximum inventory size formula", \
+    "uilabel": "Maximum inventory size formula", \
+    "doc": "formula of the relative time `t` (timesteps since the deployment" \
+           " of the facility) defining the maximum inventory size, e.g., " \
+           "`100 * 1.02^t` or `if(t % 12 == 11, 0, 100)`. If set, it " \
+           "replaces all other `max_inv_size_*` schedule variables. See " \
+           "`schedule_expression.h` for the syntax." \
+  }
+  std::string max_inv_size_expr;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "tooltip": "seed of random schedule functions", \
+    "uilabel": "Schedule seed", \
+    "doc": "seed of the random functions (e.g., `normal(mean, stddev)`) " \
+           "used in `max_inv_size_expr`. Together with the agent id and the " \
+           "`ensemble_member` it determines the random values, i.e., " \
+           "runs with the same seed and ensemble member are reproducible." \
+  }
+  int schedule_seed;
+
+  #pragma cyclus var { \
+    "default": -1, \
+    "tooltip": "ensemble member of random schedule functions", \
+    "uilabel": "Ensemble member", \
+    "doc": "member of an ensemble run, combined with `schedule_seed` for " \
+           "the random functions used in `max_inv_size_expr`. " \
+           "If negative, it is taken from the environment variable " \
+           "FLEXICAMORE_ENSEMBLE_MEMBER (0 if not set) when the agent " \
+           "enters the simulation and stored, such that the member used is " \
+           "recorded with the agent state." \
+  }
+  int ensemble_member;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "internal": True, \
+    "doc": "position in the maximum inventory size schedule, stored such that restarted " \
+           "simulations continue from there." \
+  }
+  int max_inv_size_idx;
+
+  #pragma cyclus var { \
+    "default": 0, \
+    "tooltip": "Maximum inventory size lookahead (timesteps)", \
+    "uilabel": "Maximum inventory size lookahead", \
+    "doc": "if positive, the inventory capacity is set to the smallest " \
+           "maximum inventory size of the current and the next " \
+           "`inv_size_lookahead` timesteps, such that no material is " \
+           "bought that would exceed an upcoming reduction of the " \
+           "capacity. 0 uses the current maximum inventory size only." \
+  }
+  int inv_size_lookahead;
   FlexibleInput<double> flexible_inv_size;
+  // Registration of `flexible_inv_size` in the simulation's ScheduleRegistry.
+  ScheduleSlot<double> inv_size_slot_;
 
   #pragma cyclus var {"default": False,\
                       "tooltip": "How to handles batches (discrete or not)",\
@@ -0,0 +1,162 @@
+#ifndef FLEXICAMORE_SRC_URANIUM_CACHE_H_
+#define FLEXICAMORE_SRC_URANIUM_CACHE_H_
+
+#include <cstddef>  // std::size_t
+#include <unordered_map>
+
+#include "cyclus.h"
+
+namespace flexicamore {
+
+// Uranium-related fractions of one composition. Mass and atom fractions are
+// relative to the whole composition, `assay_mass` and `assay_atom` are the
+// U235 fractions of the uranium (U235 and U238) only.
+struct UraniumFractions {
+  double u235_mass;
+  double u238_mass;
+  double uranium_mass;  // u235_mass + u238_mass
+  double u235_atom;
+  double u238_atom;
+  double uranium_atom;  // u235_atom + u238_atom
+  double assay_mass;
+  double assay_atom;
+};
+
+// Per-process cache of the `UraniumFractions` of compositions.
+//
+// The enrichment facilities query the same few compositions (feed, product
+// and tails recipes) thousands of times per timestep. Building a
+// `cyclus::toolkit::MatQuery` copies and normalises the composition for each
+// query, hence the fractions are computed once per composition instead.
+// Compositions are immutable and their ids are unique within a process, so
+// the id is used as key. Temporary compositions (e.g., of materials created
+// on the fly) would make the cache grow without bound, therefore it is
+// emptied once it holds `kMaxSize` compositions.
+//
+// The cache also holds the uranium-only composition of each composition (see
+// `UraniumComp`), such that the offers of successive biddings share their
+// compositions and, in turn, their cache entries.
+class UraniumCache {
+ public:
+  static constexpr std::size_t kMaxSize = 4096;
+
+  static UraniumFractions Get(cyclus::Composition::Ptr comp) {
+    if (!Enabled_()) {
+      return Compute_(comp);
+    }
+    Map& cache = Cache_();
+    Map::const_iterator it = cache.find(comp->id());
+    if (it != cache.end()) {
+      return it->second;
+    }
+    if (cache.size() >= kMaxSize) {
+      cache.clear();
+    }
+    UraniumFractions fractions = Compute_(comp);
+    cache[comp->id()] = fractions;
+    return fractions;
+  }
+
+  static inline UraniumFractions Get(cyclus::Material::Ptr mat) {
+    return Get(mat->comp());
+  }
+
+  // U235 mass fraction of the uranium in `mat`, equivalent to
+  // `cyclus::toolkit::UraniumAssayMass`.
+  static inline double AssayMass(cyclus::Material::Ptr mat) {
+    return mat->quantity() == 0 ? 0 : Get(mat->comp()).assay_mass;
+  }
+
+  // Composition holding only the U235 and U238 of `comp`, with the same
+  // atom ratio, as offered by the enrichment facilities.
+  static cyclus::Composition::Ptr UraniumComp(cyclus::Composition::Ptr comp) {
+    if (!Enabled_()) {
+      return ComputeUraniumComp_(comp);
+    }
+    CompCache& cache = CompCache_();
+    CompCache::const_iterator it = cache.find(comp->id());
+    if (it != cache.end()) {
+      return it->second;
+    }
+    if (cache.size() >= kMaxSize) {
+      cache.clear();
+    }
+    cyclus::Composition::Ptr uranium_comp = ComputeUraniumComp_(comp);
+    cache[comp->id()] = uranium_comp;
+    return uranium_comp;
+  }
+
+  // Enable or disable the cache, e.g., to measure its effect. Disabling it
+  // also empties it.
+  static void set_enabled(bool enabled) {
+    Enabled_() = enabled;
+    Cache_().clear();
+    CompCache_().clear();
+  }
+
+  static inline std::size_t size() { return Cache_().size(); }
+
+ private:
+  typedef std::unordered_map<int, UraniumFractions> Map;
+  typedef std::unordered_map<int, cyclus::Composition::Ptr> CompCache;
+
+  static cyclus::Composition::Ptr ComputeUraniumComp_(
+      cyclus::Composition::Ptr comp) {
+    UraniumFractions fractions = Get(comp);
+    cyclus::CompMap cm;
+    cm[922350000] = fractions.u235_atom;
+    cm[922380000] = fractions.u238_atom;
+    return cyclus::Composition::CreateFromAtom(cm);
+  }
+
+  static UraniumFractions Compute_(cyclus::Composition::Ptr comp) {
+    UraniumFractions f = UraniumFractions();
+    Fractions_(comp->mass(), &f.u235_mass, &f.u238_mass);
+    Fractions_(comp->atom(), &f.u235_atom, &f.u238_atom);
+    f.uranium_mass = f.u235_mass + f.u238_mass;
+    f.uranium_atom = f.u235_atom + f.u238_atom;
+    f.assay_mass = f.uranium_mass > 0 ? f.u235_mass / f.uranium_mass : 0;
+    f.assay_atom = f.uranium_atom > 0 ? f.u235_atom / f.uranium_atom : 0;
+    return f;
+  }
+
+  // Normalised fractions of U235 and U238 in `cm`, without copying it.
+  static void Fractions_(const cyclus::CompMap& cm, double* u235,
+                         double* u238) {
+    double total = 0;
+    *u235 = 0;
+    *u238 = 0;
+    cyclus::CompMap::const_iterator it;
+    for (it = cm.begin(); it != cm.end(); ++it) {
+      total += it->second;
+      if (it->first == 922350000) {
+        *u235 = it->second;
+      } else if (it->first == 922380000) {
+        *u238 = it->second;
+      }
+    }
+    if (total > 0) {
+      *u235 /= total;
+      *u238 /= total;
+    }
+  }
+
+  static Map& Cache_() {
+    static Map cache;
+    return cache;
+  }
+
+  static CompCache& CompCache_() {
+    static CompCache cache;
+    return cache;
+  }
+
+  static bool& Enabled_() {
+    static bool enabled = true;
+    return enabled;
+  }
+};
+
+}  // namespace flexicamore
+
+#endif  // FLEXICAMORE_SRC_URANIUM_CACHE_H_
@@ -0,0 +1,63 @@
+#ifndef FLEXICAMORE_SRC_URANIUM_TALLY_H_
+#define FLEXICAMORE_SRC_URANIUM_TALLY_H_
+
+#include "cyclus.h"
+
+#include "uranium_cache.h"
+
+namespace flexicamore {
+
+// Running U235, U238 and total masses of the materials in a feed inventory.
+//
+// Determining the feed assay from the `ResBuf` itself requires popping and
+// squashing all of its materials into a new one and pushing it back. The
+// tally is updated whenever material enters or leaves the inventory instead,
+// such that the assay and the uranium fraction are O(1) reads which neither
+// create resources nor touch the `ResourceTracker`.
+class UraniumTally {
+ public:
+  UraniumTally() : u235_(0), u238_(0), quantity_(0) {}
+
+  // Account for `mat` having been pushed into the inventory.
+  inline void Add(cyclus::Material::Ptr mat) {
+    UraniumFractions fractions = UraniumCache::Get(mat);
+    u235_ += fractions.u235_mass * mat->quantity();
+    u238_ += fractions.u238_mass * mat->quantity();
+    quantity_ += mat->quantity();
+  }
+
+  // Set the tally to the content of an inventory holding only `mat` (or
+  // nothing if `mat` is NULL). Used after the inventory has been squashed,
+  // which also discards accumulated rounding errors.
+  inline void Reset(cyclus::Material::Ptr mat) {
+    u235_ = 0;
+    u238_ = 0;
+    quantity_ = 0;
+    if (mat != NULL) {
+      Add(mat);
+    }
+  }
+
+  // U235 mass fraction of the uranium (U235 and U238), as computed by
+  // `cyclus::toolkit::UraniumAssayMass` for the squashed inventory.
+  inline double assay() const {
+    double uranium = u235_ + u238_;
+    return uranium > 0 ? u235_ / uranium : 0;
+  }
+
+  // Mass fraction of U235 and U238 in the inventory.
+  inline double uranium_frac() const {
+    return quantity_ > 0 ? (u235_ + u238_) / quantity_ : 0;
+  }
+
+  inline double quantity() const { return quantity_; }
+
+ private:
+  double u235_;
+  double u238_;
+  double quantity_;
+};
+
+}  // namespace flexicamore
+
+#endif  // FLEXICAMORE_SRC_URANIUM_TALLY_H_